@@ -0,0 +1,450 @@
+/*
+  Binary framed protocol for scripted memory and register access
+  
+  Frame (both directions, multi-byte fields are little endian):
+  
+    SYNC (0xA5) | OP (1) | LEN (2) | PAYLOAD (LEN, max 1024) | CRC16 (2)
+  
+    CRC16 is CRC-16/CCITT-FALSE over OP, LEN and PAYLOAD. Responses use OP | 0x80
+    (0xFF if the request was corrupt) and start their payload with a status byte.
+  
+  Requests:
+  
+    0x00 PING         : -> version (1), max payload (2)
+    0x01 READ         : {width (1), addr (4)} ... -> value (width) ...
+    0x02 WRITE        : {width (1), addr (4), value (width)} ...
+    0x03 POLL         : addr (4), mask (4), value (4), timeout usec (4) -> last value (4)
+    0x04 READ_BLOCK   : addr (4), count (2) -> data (count)
+    0x05 WRITE_BLOCK  : addr (4), data ...
+    0x0F RESET        : leave binary mode, back to the text terminal
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include <string.h>
+#include "simple_stdio.h"
+#include "terminal.h"
+#include "timer.h"
+#include "crc.h"
+
+#define BIN_SYNC 0xA5
+#define BIN_VERSION 1
+#define BIN_MAX_PAYLOAD 1024
+#define BIN_BYTE_TIMEOUT 100000 // usec allowed between bytes of a frame before resyncing
+
+#define BIN_OP_PING        0x00
+#define BIN_OP_READ        0x01
+#define BIN_OP_WRITE       0x02
+#define BIN_OP_POLL        0x03
+#define BIN_OP_READ_BLOCK  0x04
+#define BIN_OP_WRITE_BLOCK 0x05
+#define BIN_OP_RESET       0x0F
+
+#define BIN_OK         0x00
+#define BIN_E_CRC      0x01
+#define BIN_E_OPCODE   0x02
+#define BIN_E_LENGTH   0x03
+#define BIN_E_WIDTH    0x04
+#define BIN_E_ABORT    0x05 // Data abort on access
+#define BIN_E_TIMEOUT  0x06 // POLL did not match in time
+
+extern volatile int _abort_data_count; // NOTE: Defined in startup.c
+
+void terminal_pause(); // NOTE: Defined in terminal_commands.c
+
+unsigned char bin_rx[BIN_MAX_PAYLOAD + 8];
+unsigned char bin_tx[BIN_MAX_PAYLOAD + 8];
+
+//
+// Little endian field helpers
+//
+
+unsigned int bin_get(unsigned char *ptr, int width)
+{
+  unsigned int val;
+  
+  val = 0;
+  while (width-- > 0)
+    val = (val << 8) | ptr[width];
+  
+  return val;
+}
+
+void bin_put(unsigned char *ptr, unsigned int val, int width)
+{
+  while (width-- > 0)
+  {
+    *ptr++ = (unsigned char) val;
+    val >>= 8;
+  }
+}
+
+//
+// Frame I/O
+//
+
+int bin_recv(int *op, int *len)
+{
+  int x;
+  int c;
+  unsigned short crc;
+  
+  do
+  {
+    c = getchar() & 0xFF;
+  } while (c != BIN_SYNC);
+  
+  // NOTE: bin_rx holds OP, LEN, PAYLOAD and CRC16 as received
+  for (x = 0; x < 3; x++)
+  {
+    if ((c = getchar_timeout(BIN_BYTE_TIMEOUT)) < 0)
+      return -1;
+    
+    bin_rx[x] = (unsigned char) c;
+  }
+  
+  *op = bin_rx[0];
+  *len = bin_get(&bin_rx[1], 2);
+  
+  // NOTE: Drain the rest of the frame, so the next sync is not looked for inside it
+  if (*len > BIN_MAX_PAYLOAD)
+  {
+    for (x = 0; x < (*len + 2); x++)
+    {
+      if (getchar_timeout(BIN_BYTE_TIMEOUT) < 0)
+        break;
+    }
+    
+    return BIN_E_LENGTH;
+  }
+  
+  for (x = 3; x < (*len + 5); x++)
+  {
+    if ((c = getchar_timeout(BIN_BYTE_TIMEOUT)) < 0)
+      return -1;
+    
+    bin_rx[x] = (unsigned char) c;
+  }
+  
+  crc = crc16(CRC16_INIT, bin_rx, *len + 3);
+  
+  if (crc != bin_get(&bin_rx[*len + 3], 2))
+    return BIN_E_CRC;
+  
+  return BIN_OK;
+}
+
+void bin_send(int op, int status, int len)
+{
+  unsigned short crc;
+  
+  // NOTE: Handlers fill in data after the status byte at bin_tx[5]
+  bin_tx[0] = BIN_SYNC;
+  bin_tx[1] = (unsigned char) op;
+  bin_put(&bin_tx[2], len + 1, 2);
+  bin_tx[4] = (unsigned char) status;
+  
+  crc = crc16(CRC16_INIT, &bin_tx[1], len + 4);
+  bin_put(&bin_tx[len + 5], crc, 2);
+  
+  write_raw((char*) bin_tx, len + 7);
+}
+
+//
+// Memory access with data abort detection
+//
+
+int bin_load(unsigned int addr, int width, unsigned int *val)
+{
+  int abt_data_old;
+  
+  abt_data_old = _abort_data_count;
+  
+  if (width == 1)
+    *val = *((volatile unsigned char*) addr);
+  else if (width == 2)
+    *val = *((volatile unsigned short*) (addr & 0xFFFFFFFE));
+  else
+    *val = *((volatile unsigned int*) (addr & 0xFFFFFFFC));
+  
+  terminal_pause();
+  
+  return (abt_data_old != _abort_data_count) ? BIN_E_ABORT : BIN_OK;
+}
+
+int bin_store(unsigned int addr, int width, unsigned int val)
+{
+  int abt_data_old;
+  
+  abt_data_old = _abort_data_count;
+  
+  if (width == 1)
+    *((volatile unsigned char*) addr) = (unsigned char) val;
+  else if (width == 2)
+    *((volatile unsigned short*) (addr & 0xFFFFFFFE)) = (unsigned short) val;
+  else
+    *((volatile unsigned int*) (addr & 0xFFFFFFFC)) = val;
+  
+  terminal_pause();
+  
+  return (abt_data_old != _abort_data_count) ? BIN_E_ABORT : BIN_OK;
+}
+
+//
+// Request handlers - return status, set '*rlen' to the bytes placed after the status
+//
+
+int bin_read(unsigned char *req, int len, unsigned char *rsp, int *rlen)
+{
+  int width;
+  int status;
+  unsigned int val;
+  
+  for (; len >= 5; len -= 5, req += 5)
+  {
+    width = req[0];
+    
+    if ((width != 1) && (width != 2) && (width != 4))
+      return BIN_E_WIDTH;
+    
+    if ((*rlen + width) > (BIN_MAX_PAYLOAD - 1))
+      return BIN_E_LENGTH;
+    
+    if ((status = bin_load(bin_get(&req[1], 4), width, &val)) != BIN_OK)
+      return status;
+    
+    bin_put(&rsp[*rlen], val, width);
+    *rlen += width;
+  }
+  
+  return (len == 0) ? BIN_OK : BIN_E_LENGTH;
+}
+
+int bin_write(unsigned char *req, int len, unsigned char *rsp, int *rlen)
+{
+  int width;
+  int status;
+  
+  while (len > 0)
+  {
+    width = req[0];
+    
+    if ((width != 1) && (width != 2) && (width != 4))
+      return BIN_E_WIDTH;
+    
+    if (len < (5 + width))
+      return BIN_E_LENGTH;
+    
+    if ((status = bin_store(bin_get(&req[1], 4), width, bin_get(&req[5], width))) != BIN_OK)
+      return status;
+    
+    len -= 5 + width;
+    req += 5 + width;
+  }
+  
+  return BIN_OK;
+}
+
+int bin_poll(unsigned char *req, int len, unsigned char *rsp, int *rlen)
+{
+  unsigned int addr;
+  unsigned int mask;
+  unsigned int match;
+  unsigned int val;
+  unsigned long long timeout;
+  int status;
+  
+  if (len != 16)
+    return BIN_E_LENGTH;
+  
+  addr = bin_get(&req[0], 4);
+  mask = bin_get(&req[4], 4);
+  match = bin_get(&req[8], 4);
+  timeout = timer_ticks() + ((unsigned long long) timer_ticks_per_us() * bin_get(&req[12], 4));
+  
+  while (1)
+  {
+    if ((status = bin_load(addr, 4, &val)) != BIN_OK)
+      break;
+    
+    if ((val & mask) == match)
+      break;
+    
+    if (timer_ticks() > timeout)
+    {
+      status = BIN_E_TIMEOUT;
+      break;
+    }
+  }
+  
+  bin_put(rsp, val, 4);
+  *rlen = 4;
+  
+  return status;
+}
+
+int bin_read_block(unsigned char *req, int len, unsigned char *rsp, int *rlen)
+{
+  unsigned int addr;
+  unsigned int val;
+  int count;
+  int status;
+  int x;
+  
+  if (len != 6)
+    return BIN_E_LENGTH;
+  
+  addr = bin_get(&req[0], 4);
+  count = bin_get(&req[4], 2);
+  
+  if (count > (BIN_MAX_PAYLOAD - 1))
+    return BIN_E_LENGTH;
+  
+  // NOTE: Word accesses when aligned, so device memory sees full width reads
+  for (x = 0; x < count; )
+  {
+    if ((((addr + x) & 3) == 0) && ((count - x) >= 4))
+    {
+      if ((status = bin_load(addr + x, 4, &val)) != BIN_OK)
+        return status;
+      
+      bin_put(&rsp[x], val, 4);
+      x += 4;
+    }
+    else
+    {
+      if ((status = bin_load(addr + x, 1, &val)) != BIN_OK)
+        return status;
+      
+      rsp[x++] = (unsigned char) val;
+    }
+  }
+  
+  *rlen = count;
+  
+  return BIN_OK;
+}
+
+int bin_write_block(unsigned char *req, int len, unsigned char *rsp, int *rlen)
+{
+  unsigned int addr;
+  int status;
+  int x;
+  
+  if (len < 4)
+    return BIN_E_LENGTH;
+  
+  addr = bin_get(&req[0], 4);
+  req += 4;
+  len -= 4;
+  
+  for (x = 0; x < len; )
+  {
+    if ((((addr + x) & 3) == 0) && ((len - x) >= 4))
+    {
+      if ((status = bin_store(addr + x, 4, bin_get(&req[x], 4))) != BIN_OK)
+        return status;
+      
+      x += 4;
+    }
+    else
+    {
+      if ((status = bin_store(addr + x, 1, req[x])) != BIN_OK)
+        return status;
+      
+      x++;
+    }
+  }
+  
+  return BIN_OK;
+}
+
+//
+// Binary mode main loop
+//
+
+int binary_mode(int argc, char** argv)
+{
+  int op;
+  int len;
+  int rlen;
+  int status;
+  unsigned char *rsp;
+  
+  puts("BINARY MODE - send RESET frame to exit");
+  flush();
+  
+  rsp = &bin_tx[5];
+  
+  while (1)
+  {
+    status = bin_recv(&op, &len);
+    
+    if (status < 0)
+      continue; // NOTE: Stalled in the middle of a frame, wait for the next sync byte
+    
+    if (status == BIN_E_CRC)
+    {
+      bin_send(0xFF, BIN_E_CRC, 0);
+      continue;
+    }
+    
+    rlen = 0;
+    
+    if (status == BIN_OK)
+    {
+      switch (op)
+      {
+      case BIN_OP_PING:
+        rsp[0] = BIN_VERSION;
+        bin_put(&rsp[1], BIN_MAX_PAYLOAD, 2);
+        rlen = 3;
+        break;
+      case BIN_OP_READ: status = bin_read(&bin_rx[3], len, rsp, &rlen); break;
+      case BIN_OP_WRITE: status = bin_write(&bin_rx[3], len, rsp, &rlen); break;
+      case BIN_OP_POLL: status = bin_poll(&bin_rx[3], len, rsp, &rlen); break;
+      case BIN_OP_READ_BLOCK: status = bin_read_block(&bin_rx[3], len, rsp, &rlen); break;
+      case BIN_OP_WRITE_BLOCK: status = bin_write_block(&bin_rx[3], len, rsp, &rlen); break;
+      case BIN_OP_RESET: break;
+      default: status = BIN_E_OPCODE; break;
+      }
+    }
+    
+    // NOTE: Partial results are dropped on error, the host gets just the status
+    if (status != BIN_OK)
+      rlen = 0;
+    
+    bin_send(op | 0x80, status, rlen);
+    
+    if ((op == BIN_OP_RESET) && (status == BIN_OK))
+      break;
+  }
+  
+  flush();
+  puts("\nTEXT MODE");
+  
+  return 0;
+}
+
+TERMINAL_COMMAND("binary", binary_mode, "Framed binary protocol for host scripts (see binary_mode.c)");
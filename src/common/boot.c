@@ -28,6 +28,10 @@ SOFTWARE.
 */
 
 #include "boot.h"
+#include "timer.h"
+#include "simple_stdio.h"
+#include "log.h"
+#include <string.h>
 
 //
 // NULL entry for boot steps table in memory
@@ -40,52 +44,655 @@ __attribute__((section(".boot_step_null"))) boot_step_t null_boot_step =
     .desc = (char*)0
   };
 
+boot_step_t *boot_sequence;
+boot_step_t *boot_current; // Step being run by boot_step_run()
+
 //
-// Boot steps main entry point (steps 1-999)
+// Warm restart state (see ocram.lds, not cleared with .bss)
 //
 
-void boot()
+extern int _retained_start; // NOTE: Defined in linker script
+extern int _retained_end;
+
+BOOT_RETAINED boot_retained_t boot_retained;
+
+int boot_warm;
+unsigned long long boot_start_ticks;
+unsigned long long boot_end_ticks;
+int boot_aborted; // Set when a BOOT_FAIL_ABORT step fails
+
+//
+// Dependency graph helpers
+//
+
+int boot_dep_listed(char *deps, char *name)
+{
+  char *ptr;
+  int len;
+  
+  len = strlen(name);
+  ptr = deps;
+  
+  while (*ptr != '\0')
+  {
+    while ((*ptr == ',') || (*ptr == ' '))
+      ptr++;
+    
+    if ((strncmp(ptr, name, len) == 0) && 
+        ((ptr[len] == '\0') || (ptr[len] == ',') || (ptr[len] == ' ')))
+      return 1;
+    
+    while ((*ptr != '\0') && (*ptr != ',') && (*ptr != ' '))
+      ptr++;
+  }
+  
+  return 0;
+}
+
+int boot_dep_count(char *deps)
+{
+  char *ptr;
+  int cnt;
+  
+  cnt = 0;
+  ptr = deps;
+  
+  while (*ptr != '\0')
+  {
+    while ((*ptr == ',') || (*ptr == ' '))
+      ptr++;
+    
+    if (*ptr != '\0')
+      cnt++;
+    
+    while ((*ptr != '\0') && (*ptr != ',') && (*ptr != ' '))
+      ptr++;
+  }
+  
+  return cnt;
+}
+
+int boot_step_depends(boot_step_t *step, boot_step_t *prereq)
+{
+  if (step == prereq)
+    return 0;
+  
+  // NOTE: Boot and shutdown are separate sequences, shutdown always runs after boot
+  if ((step->step < 1000) != (prereq->step < 1000))
+    return 0;
+  
+  if (step->deps == (char*)0)
+    return (prereq->step < step->step);
+  
+  return boot_dep_listed(step->deps, prereq->name);
+}
+
+// NOTE: Looks up the sets built by boot_schedule()
+int boot_step_requires(boot_step_t *step, boot_step_t *prereq)
+{
+  if ((step->index < 0) || (prereq->index < 0))
+    return (prereq->level < step->level) && boot_step_depends(step, prereq);
+  
+  return (step->requires[prereq->index >> 5] >> (prereq->index & 31)) & 1;
+}
+
+//
+// Build the 'requires' set of every step, lowest level first
+// - Prerequisites always have a lower level (which also breaks circular prerequisites)
+//
+
+void boot_schedule_requires(int max_level)
 {
-  int step_num;
   boot_step_t *boot_step;
+  boot_step_t *prereq;
+  int level;
+  int x;
   
-  for (step_num = 1; step_num < 1000; step_num++)
+  for (level = 0; level <= max_level; level++)
   {
     boot_step = boot_steps;
-    
     while (boot_step->desc != (char*)0)
     {
-      if (boot_step->step == step_num)
-        boot_step->entry(step_num);
+      if ((boot_step->level == level) && (boot_step->index >= 0))
+      {
+        prereq = boot_steps;
+        while (prereq->desc != (char*)0)
+        {
+          if ((prereq->index >= 0) && (prereq->level < level) && boot_step_depends(boot_step, prereq))
+          {
+            boot_step->requires[prereq->index >> 5] |= 1 << (prereq->index & 31);
+            
+            for (x = 0; x < (BOOT_STEPS_MAX / 32); x++)
+              boot_step->requires[x] |= prereq->requires[x];
+          }
+          
+          prereq++;
+        }
+      }
       
       boot_step++;
     }
   }
-  
-  return;
+}
+
+int boot_steps_independent(boot_step_t *a, boot_step_t *b)
+{
+  return !boot_step_requires(a, b) && !boot_step_requires(b, a);
 }
 
 //
-// Shutdown steps main entry point (steps 1000-1999)
+// Topological sort of the boot steps table into 'boot_sequence'
+// - Ready steps are taken in step order, so steps without BOOT_STEP_DEPS keep their order
+// - Boot steps (1-999) are all scheduled before shutdown steps (1000-1999)
 //
 
-void shutdown()
+void boot_schedule()
 {
-  int step_num;
   boot_step_t *boot_step;
+  boot_step_t *prereq;
+  boot_step_t *ready;
+  boot_step_t **link;
+  int matched;
+  int boot_left;
+  int max_level;
+  int x;
   
-  for (step_num = 1000; step_num < 2000; step_num++)
+  boot_left = 0;
+  boot_step = boot_steps;
+  while (boot_step->desc != (char*)0)
   {
+    boot_step->next = (boot_step_t*)0;
+    boot_step->level = 0;
+    boot_step->pending = 0;
+    boot_step->index = ((boot_step - boot_steps) < BOOT_STEPS_MAX) ? (boot_step - boot_steps) : -1;
+    matched = 0;
+    
+    for (x = 0; x < (BOOT_STEPS_MAX / 32); x++)
+      boot_step->requires[x] = 0;
+    
+    if (boot_step->index < 0)
+      printf("WARNING: Boot step %i is past BOOT_STEPS_MAX, only direct prerequisites are known\n", boot_step->step);
+    
+    if (boot_step->step < 1000)
+      boot_left++;
+    
+    prereq = boot_steps;
+    while (prereq->desc != (char*)0)
+    {
+      if (boot_step_depends(boot_step, prereq))
+        boot_step->pending++;
+      
+      if ((boot_step->deps != (char*)0) && (prereq != boot_step) && 
+          boot_dep_listed(boot_step->deps, prereq->name))
+        matched++;
+      
+      prereq++;
+    }
+    
+    if ((boot_step->deps != (char*)0) && (matched != boot_dep_count(boot_step->deps)))
+      printf("WARNING: Boot step %i has unknown prerequisites (%s)\n", boot_step->step, boot_step->deps);
+    
+    boot_step++;
+  }
+  
+  link = &boot_sequence;
+  
+  while (1)
+  {
+    ready = (boot_step_t*)0;
+    
     boot_step = boot_steps;
+    while (boot_step->desc != (char*)0)
+    {
+      // NOTE: Table is sorted, so no shutdown steps until all boot steps are done
+      if ((boot_step->step >= 1000) && (boot_left > 0))
+        break;
+      
+      if (boot_step->pending == 0)
+      {
+        ready = boot_step;
+        break;
+      }
+      
+      boot_step++;
+    }
     
+    if (ready == (boot_step_t*)0)
+    {
+      boot_step = boot_steps;
+      while ((boot_step->desc != (char*)0) && (boot_step->pending < 0))
+        boot_step++;
+      
+      if (boot_step->desc == (char*)0)
+        break;
+      
+      printf("ERROR: Boot step %i has circular prerequisites - running it in step order\n", boot_step->step);
+      ready = boot_step;
+    }
+    
+    if (ready->step < 1000)
+      boot_left--;
+    
+    ready->pending = -1;
+    *link = ready;
+    link = &(ready->next);
+    
+    boot_step = boot_steps;
     while (boot_step->desc != (char*)0)
     {
-      if (boot_step->step == step_num)
-        boot_step->entry(step_num);
+      if ((boot_step->pending > 0) && boot_step_depends(boot_step, ready))
+      {
+        boot_step->pending--;
+        
+        if (boot_step->level <= ready->level)
+          boot_step->level = ready->level + 1;
+      }
       
       boot_step++;
     }
   }
   
+  *link = (boot_step_t*)0;
+  
+  max_level = 0;
+  boot_step = boot_steps;
+  while (boot_step->desc != (char*)0)
+  {
+    if (boot_step->level > max_level)
+      max_level = boot_step->level;
+    
+    boot_step++;
+  }
+  
+  boot_schedule_requires(max_level);
+  
+  return;
+}
+
+//
+// Time budget helpers
+//
+
+int boot_step_overrun(boot_step_t *boot_step)
+{
+  unsigned long long budget;
+  
+  if (boot_step->budget_us == 0)
+    return 0;
+  
+  budget = (unsigned long long) boot_step->budget_us * timer_ticks_per_us();
+  
+  return (timer_ticks() - boot_step->start) > budget;
+}
+
+int boot_step_expired()
+{
+  unsigned int mpidr;
+  
+  // NOTE: Only CPU0 runs boot steps, 'boot_current' means nothing to a job on CPU1
+  __asm volatile("MRC p15, 0, %0, c0, c0, 5;\n" : "=r" (mpidr));
+  
+  if ((mpidr & 3) != 0)
+    return 0;
+  
+  if (boot_current == (boot_step_t*)0)
+    return 0;
+  
+  return boot_step_overrun(boot_current);
+}
+
+//
+// Report on a finished step and apply its failure policy
+//
+
+void boot_step_end(boot_step_t *boot_step)
+{
+  if ((boot_step->budget_us != 0) && (boot_step->usec > boot_step->budget_us))
+    printf("ERROR: Step %i (%s) took %u usec, budget is %u usec\n", 
+      boot_step->step, boot_step->name, boot_step->usec, boot_step->budget_us);
+  
+  if (boot_step->status == 0)
+  {
+    boot_step->done = 1;
+    return;
+  }
+  
+  if (boot_step->status == BOOT_TIMEOUT)
+    printf("ERROR: Step %i (%s) abandoned, out of time\n", boot_step->step, boot_step->name);
+  else
+    printf("ERROR: Step %i (%s) failed, error code (%i)\n", boot_step->step, boot_step->name, boot_step->status);
+  
+  if ((boot_step->flags & BOOT_FAIL_ABORT) && (boot_step->step < 1000))
+    boot_aborted = 1;
+  
+  return;
+}
+
+//
+// Check if a step must be skipped because a BOOT_FAIL_SKIP step it requires failed
+//
+
+int boot_step_blocked(boot_step_t *step)
+{
+  boot_step_t *boot_step;
+  
+  boot_step = boot_steps;
+  while (boot_step->desc != (char*)0)
+  {
+    if ((boot_step->flags & BOOT_FAIL_SKIP) && 
+        (boot_step->status != 0) && (boot_step->status != BOOT_BUSY) && (boot_step->status != BOOT_NOT_RUN) &&
+        boot_step_requires(step, boot_step))
+    {
+      LOG_INFO("Skipping step %i (%s), step %i (%s) failed", 
+        step->step, step->name, boot_step->step, boot_step->name);
+      
+      step->status = BOOT_BLOCKED;
+      return 1;
+    }
+    
+    boot_step++;
+  }
+  
+  return 0;
+}
+
+//
+// Call a step (retrying if allowed) and record how long it took
+//
+
+void boot_step_run(boot_step_t *boot_step)
+{
+  int rtn;
+  int tries;
+  
+  boot_current = boot_step;
+  
+  boot_step->start = timer_ticks();
+  
+  for (tries = 0; ; tries++)
+  {
+    rtn = boot_step->entry(boot_step->step);
+    
+    if ((rtn == 0) || (tries >= boot_step->retries) || boot_step_expired())
+      break;
+    
+    LOG_INFO("Retrying step %i (%s), error code (%i)", boot_step->step, boot_step->name, rtn);
+  }
+  
+  boot_step->ticks = timer_ticks() - boot_step->start;
+  boot_step->usec = timer_ticks_to_us(boot_step->ticks);
+  boot_step->entry_usec = boot_step->usec;
+  
+  boot_current = (boot_step_t*)0;
+  
+  LOG_DEBUG("Step %i (%s) returned %i after %u usec", boot_step->step, boot_step->name, rtn, boot_step->usec);
+  
+  if (rtn != 0)
+  {
+    // NOTE: Failed steps should not leave work behind, but make sure it is never polled
+    boot_step->async_poll = (void*)0;
+    boot_step->async_done = (void*)0;
+  }
+  else if (boot_step->async_poll != (void*)0)
+  {
+    boot_step->status = BOOT_BUSY;
+    return;
+  }
+  
+  boot_step->status = rtn;
+  boot_step_end(boot_step);
+  
+  return;
+}
+
+//
+// Check if a step can be skipped on a warm restart
+//
+
+int boot_step_skip(boot_step_t *boot_step)
+{
+  if (!boot_warm || !boot_step->done || !(boot_step->flags & BOOT_WARM_SKIP))
+    return 0;
+  
+  if ((boot_step->warm_valid != (void*)0) && !boot_step->warm_valid(boot_step->step))
+    return 0;
+  
+  boot_step->ticks = 0;
+  boot_step->usec = 0;
+  boot_step->entry_usec = 0;
+  boot_step->status = 0;
+  boot_step->skipped = 1;
+  
+  return 1;
+}
+
+//
+// Restart from _startup(), keeping retained state if 'warm'
+//
+
+extern void _startup();
+
+void boot_restart(int warm)
+{
+  boot_retained.magic = BOOT_RETAINED_MAGIC;
+  boot_retained.flags = (warm) ? BOOT_RETAINED_WARM : 0;
+  
+  // NOTE: Nothing can take an interrupt until boot steps 120-150 run again
+  __asm volatile("cpsid i;\n");
+  
+  _startup();
+}
+
+//
+// Asynchronous step support
+//
+
+void boot_async(int (*poll)(void *arg), void (*done)(int rtn, void *arg), void *arg, int background)
+{
+  int rtn;
+  
+  // NOTE: Not called from a boot step, so nothing to overlap with
+  if (boot_current == (boot_step_t*)0)
+  {
+    do
+    {
+      rtn = poll(arg);
+    } while (rtn == BOOT_BUSY);
+    
+    if (done)
+      done(rtn, arg);
+    
+    return;
+  }
+  
+  boot_current->async_poll = poll;
+  boot_current->async_done = done;
+  boot_current->async_arg = arg;
+  boot_current->async_background = background;
+  
+  return;
+}
+
+int boot_async_check(boot_step_t *boot_step)
+{
+  int rtn;
+  void (*done)(int rtn, void *arg);
+  boot_step_t *current;
+  
+  if (boot_step->async_poll == (void*)0)
+    return 0;
+  
+  // NOTE: Lets boot_step_expired() work from inside 'poll'
+  current = boot_current;
+  boot_current = boot_step;
+  rtn = boot_step->async_poll(boot_step->async_arg);
+  boot_current = current;
+  
+  if (rtn == BOOT_BUSY)
+  {
+    // NOTE: Background work can not be stopped, it is only reported once it finishes
+    if (boot_step->async_background || !boot_step_overrun(boot_step))
+      return 1;
+    
+    rtn = BOOT_TIMEOUT;
+  }
+  
+  // NOTE: Profile covers the whole operation, not just the step entry
+  boot_step->ticks = timer_ticks() - boot_step->start;
+  boot_step->usec = timer_ticks_to_us(boot_step->ticks);
+  
+  done = boot_step->async_done;
+  boot_step->async_poll = (void*)0;
+  boot_step->async_done = (void*)0;
+  
+  if (done)
+    done(rtn, boot_step->async_arg);
+  
+  boot_step->status = rtn;
+  boot_step_end(boot_step);
+  
+  return 0;
+}
+
+void boot_async_poll()
+{
+  boot_step_t *boot_step;
+  
+  boot_step = boot_steps;
+  while (boot_step->desc != (char*)0)
+  {
+    boot_async_check(boot_step);
+    boot_step++;
+  }
+  
+  return;
+}
+
+void boot_async_wait(boot_step_t *step)
+{
+  boot_step_t *boot_step;
+  
+  boot_step = boot_steps;
+  while (boot_step->desc != (char*)0)
+  {
+    if ((boot_step->async_poll != (void*)0) && boot_step_requires(step, boot_step))
+      while (boot_async_check(boot_step));
+    
+    boot_step++;
+  }
+  
+  return;
+}
+
+void boot_async_finish(int background)
+{
+  boot_step_t *boot_step;
+  
+  boot_step = boot_steps;
+  while (boot_step->desc != (char*)0)
+  {
+    if ((boot_step->async_poll != (void*)0) && (background || !boot_step->async_background))
+      while (boot_async_check(boot_step));
+    
+    boot_step++;
+  }
+  
+  return;
+}
+
+void boot_async_wait_all()
+{ boot_async_finish(1); }
+
+//
+// Boot steps main entry point (steps 1-999)
+//
+
+void boot()
+{
+  boot_step_t *boot_step;
+  
+  // NOTE: Retained memory is random after power up, only trust it if 'restart' set it
+  boot_warm = (boot_retained.magic == BOOT_RETAINED_MAGIC) && 
+              (boot_retained.flags & BOOT_RETAINED_WARM);
+  
+  if (!boot_warm)
+    memset((void*)&_retained_start, 0, (int) &_retained_end - (int) &_retained_start);
+  
+  boot_retained.magic = 0;
+  boot_retained.flags = 0;
+  
+  timer_init();
+  boot_start_ticks = timer_ticks();
+  boot_end_ticks = 0;
+  boot_schedule();
+  
+  // NOTE: Forget about anything left over from before a 'restart'
+  boot_step = boot_steps;
+  while (boot_step->desc != (char*)0)
+  {
+    boot_step->async_poll = (void*)0;
+    boot_step->async_done = (void*)0;
+    boot_step->status = BOOT_NOT_RUN;
+    boot_step->ticks = 0;
+    boot_step->usec = 0;
+    boot_step->entry_usec = 0;
+    boot_step->skipped = 0;
+    
+    if (!boot_warm)
+      boot_step->done = 0;
+    
+    boot_step++;
+  }
+  
+  boot_aborted = 0;
+  boot_step = boot_sequence;
+  
+  while ((boot_step != (boot_step_t*)0) && (boot_step->step < 1000))
+  {
+    boot_async_poll();
+    boot_async_wait(boot_step);
+    
+    if (boot_aborted)
+      break;
+    
+    if (!boot_step_skip(boot_step) && !boot_step_blocked(boot_step))
+      boot_step_run(boot_step);
+    
+    if (boot_aborted)
+      break;
+    
+    boot_step = boot_step->next;
+  }
+  
+  if (boot_aborted)
+    puts("ERROR: Boot aborted, remaining steps not run");
+  
+  boot_async_finish(0);
+  boot_end_ticks = timer_ticks();
+  
+  return;
+}
+
+//
+// Shutdown steps main entry point (steps 1000-1999)
+//
+
+void shutdown()
+{
+  boot_step_t *boot_step;
+  
+  boot_async_wait_all();
+  
+  boot_step = boot_sequence;
+  
+  while ((boot_step != (boot_step_t*)0) && (boot_step->step < 1000))
+    boot_step = boot_step->next;
+  
+  while (boot_step != (boot_step_t*)0)
+  {
+    boot_step_run(boot_step);
+    boot_step = boot_step->next;
+  }
+  
   return;
 }
@@ -32,12 +32,12 @@ SOFTWARE.
 #include "alt_interrupt.h"
 #include "boot.h"
 
-void wdog_stop(int step)
-{ alt_wdog_stop(ALT_WDOG0); }
+int wdog_stop(int step)
+{ return alt_wdog_stop(ALT_WDOG0); }
 
 #define WRITE_REG32(ADDR, VAL) *((volatile unsigned int*) ADDR) = VAL
 
-void disable_fw(int step)
+int disable_fw(int step)
 {
   WRITE_REG32(0xFFD13000,0x01010101);
   WRITE_REG32(0xFFD13004,0x01010101);
@@ -148,35 +148,35 @@ void disable_fw(int step)
   WRITE_REG32(0xFFD13428,0x0);
   WRITE_REG32(0xFFD1342C,0x0);
 
-  return;
+  return 0;
 }
 
-void int_global_init(int step)
-{ alt_int_global_init(); }
+int int_global_init(int step)
+{ return alt_int_global_init(); }
 
-void int_cpu_init(int step)
-{ alt_int_cpu_init(); }
+int int_cpu_init(int step)
+{ return alt_int_cpu_init(); }
 
-void int_global_enable_all(int step)
-{ alt_int_global_enable_all(); }
+int int_global_enable_all(int step)
+{ return alt_int_global_enable_all(); }
 
-void int_cpu_enable(int step)
-{ alt_int_cpu_enable(); }
+int int_cpu_enable(int step)
+{ return alt_int_cpu_enable(); }
 
-void int_cpu_disable(int step)
-{ alt_int_cpu_disable(); }
+int int_cpu_disable(int step)
+{ return alt_int_cpu_disable(); }
 
-void int_global_disable_all(int step)
-{ alt_int_global_disable_all(); }
+int int_global_disable_all(int step)
+{ return alt_int_global_disable_all(); }
 
-void int_cpu_uninit(int step)
-{ alt_int_cpu_uninit(); }
+int int_cpu_uninit(int step)
+{ return alt_int_cpu_uninit(); }
 
-void int_global_uninit(int step)
-{ alt_int_global_uninit(); }
+int int_global_uninit(int step)
+{ return alt_int_global_uninit(); }
 
 
-BOOT_STEP(10, disable_fw, "disable noc firewalls");
+BOOT_STEP_OPTS(10, disable_fw, "disable noc firewalls", .flags = BOOT_WARM_SKIP);
 BOOT_STEP(100, wdog_stop, "stop watchdog");
 
 BOOT_STEP(120, int_global_init, "init global interrupt");
@@ -39,6 +39,25 @@ static void* page_table_alloc(const size_t size, void* context)
 
 extern int _stack_end;
 
+uint32_t *mmu_ttb1; // NOTE: Shared with CPU1 so both cores use the same page table
+
+//
+// Join the SCU coherency domain (ACTLR.SMP and ACTLR.FW) so that OCRAM
+// stays coherent between CPU0 and CPU1. Called by each core before it
+// enables its own caches.
+//
+
+void cache_smp_enable(void)
+{
+    uint32_t actlr;
+    
+    __asm volatile("MRC p15, 0, %0, c1, c0, 1;\n" : "=r" (actlr));
+    actlr |= 0x00000041;
+    __asm volatile("MCR p15, 0, %0, c1, c0, 1;\n" : : "r" (actlr));
+    
+    return;
+}
+
 static ALT_STATUS_CODE mmu_init(void)
 {
     void* mmu_table;
@@ -119,10 +138,15 @@ static ALT_STATUS_CODE mmu_init(void)
         status = alt_mmu_va_space_enable(ttb1);
     }
 
+    if (status == ALT_E_SUCCESS)
+    {
+        mmu_ttb1 = ttb1;
+    }
+
     return status;
 }
 
-void enable_cache(int boot_step)
+int enable_cache(int boot_step)
 {
     ALT_STATUS_CODE status = ALT_E_SUCCESS;
     
@@ -130,21 +154,31 @@ void enable_cache(int boot_step)
     if(status == ALT_E_SUCCESS)
         status = mmu_init();
 
+    // Enabling SCU and SMP mode (so CPU1 can share cached OCRAM)
+    if(status == ALT_E_SUCCESS)
+    {
+        *((volatile uint32_t*) 0xFFFFC000) |= 0x00000001;
+        cache_smp_enable();
+    }
+
     // Enabling caches
     if(status == ALT_E_SUCCESS)
         status = alt_cache_system_enable();
 
     if(status != ALT_E_SUCCESS)
+    {
+        mmu_ttb1 = NULL; // NOTE: CPU1 only turns on its caches if CPU0 did
         printf("ERROR: Unable to start caching subsystem\n");
+    }
       
-    return;
+    return status;
 }
 
-void disable_cache(int boot_step)
+int disable_cache(int boot_step)
 {
+    mmu_ttb1 = NULL;
     alt_cache_system_disable();
-    alt_mmu_disable();
-    return;
+    return alt_mmu_disable();
 }
 
 BOOT_STEP(110, enable_cache, "enable mmu and cache");
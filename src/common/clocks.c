@@ -29,11 +29,12 @@ SOFTWARE.
 
 #include "alt_clock_manager.h"
 #include "terminal.h"
+#include "boot.h"
 #include "simple_stdio.h"
 #include <string.h>
 
-__attribute__((weak)) void stdio_init(int step)  // NOTE: Required to ensure baud rate
-{ return; }                                      //       is re-calculated after a clock
+__attribute__((weak)) int stdio_init(int step)   // NOTE: Required to ensure baud rate
+{ return 0; }                                    //       is re-calculated after a clock
                                                  //       rate change. This is a weak
                                                  //       function just in case.
 
@@ -44,7 +45,7 @@ __attribute__((weak)) void stdio_init(int step)  // NOTE: Required to ensure bau
 extern CLOCK_MANAGER_CONFIG clock_config;
 extern CLOCK_SOURCE_CONFIG clock_src_clks;
 
-volatile int clock_settings_pending;
+BOOT_RETAINED volatile int clock_settings_pending;
 
 //
 // Clock Helper Lookup Tables
@@ -216,6 +217,7 @@ int clock_setting(int argc, char** argv)
   int x;
   unsigned int setting;
   unsigned int uart_baud;
+  char *end;
   
   if (argc == 2)
   {
@@ -234,6 +236,7 @@ int clock_setting(int argc, char** argv)
       flush();
       alt_clkmgr_config(&clock_config, &clock_src_clks);
       stdio_init(0); // NOTE: Just in case the baud rate is modified
+      stdio_irq_rearm();
 
       clock_settings_pending = 0;
       puts("\n  Settings Updated");
@@ -248,7 +251,8 @@ int clock_setting(int argc, char** argv)
     for (x = 0; clock_setting_names[x].name != (char*)0; x++)
       if (strcmp(argv[1], clock_setting_names[x].name) == 0)
       {
-        if (sscanf(argv[2], "%u", &setting) != 1)
+        setting = strtou32(argv[2], &end, 0);
+        if ((end == argv[2]) || (*end != '\0'))
         {
           puts("ERROR: Argument 2 must be a number");
           return -1;
@@ -0,0 +1,259 @@
+/*
+  Second Cortex-A9 core (CPU1) as a boot worker
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include "alt_cache.h"
+#include "alt_mmu.h"
+#include "boot.h"
+#include "terminal.h"
+#include "simple_stdio.h"
+#include "cpu1.h"
+#include "timer.h"
+
+#define CPU1_JOBS 8 // NOTE: Must be a power of 2
+
+#define RSTMGR_MPUMODRST ((volatile unsigned int*) 0xFFD05020)
+#define SYSMGR_CPU1STARTADDR ((volatile unsigned int*) 0xFFD06230)
+
+#define DMB() __asm volatile("dmb;\n" : : : "memory")
+#define SEV() __asm volatile("dsb;\nsev;\n" : : : "memory")
+#define WFE() __asm volatile("wfe;\n" : : : "memory")
+
+void _startup(); // NOTE: Sends CPU1 to _startup_cpu1()
+void cache_smp_enable(void);
+extern uint32_t *mmu_ttb1;
+extern int _start;
+extern int _stack_end;
+
+//
+// Job queue shared by both cores
+// - CPU0 only writes 'cpu1_head' and new jobs, CPU1 only writes 'cpu1_tail' and results
+// - Job numbers count up forever, the slot is (job & (CPU1_JOBS - 1))
+//
+
+struct
+{
+  int (*func)(void *arg);
+  void *arg;
+  int rtn;
+} cpu1_jobs[CPU1_JOBS];
+
+volatile unsigned int cpu1_head;
+volatile unsigned int cpu1_tail;
+volatile int cpu1_running;
+
+// NOTE: Written by CPU1 with its caches off, so it has a cache line to itself that
+//       CPU0 can invalidate while it waits (see cpu1_stop)
+volatile int cpu1_parked[8] __attribute__((aligned(32)));
+
+//
+// CPU1 side
+//
+
+void cpu1_main()
+{
+  unsigned int job;
+  
+  // NOTE: Follow CPU0 - only turn on the MMU and caches if CPU0 has them on
+  if (mmu_ttb1 != NULL)
+  {
+    alt_cache_l1_data_invalidate_all();
+    cache_smp_enable();
+    alt_mmu_init();
+    alt_mmu_va_space_enable(mmu_ttb1);
+    alt_cache_l1_enable_all();
+  }
+  
+  cpu1_running = 1;
+  SEV();
+  
+  while (1)
+  {
+    job = cpu1_tail;
+    
+    while (job == cpu1_head)
+      WFE();
+    
+    DMB();
+    
+    cpu1_jobs[job & (CPU1_JOBS - 1)].rtn = 
+      cpu1_jobs[job & (CPU1_JOBS - 1)].func(cpu1_jobs[job & (CPU1_JOBS - 1)].arg);
+    
+    DMB();
+    cpu1_tail = job + 1;
+    SEV();
+  }
+}
+
+int cpu1_park(void *arg)
+{
+  // NOTE: Write back anything only CPU1 has before it goes into reset
+  if (mmu_ttb1 != NULL)
+  {
+    alt_cache_l1_disable_all();
+    alt_mmu_disable();
+  }
+  
+  cpu1_parked[0] = 1;
+  SEV();
+  
+  while (1)
+    WFE();
+  
+  return 0;
+}
+
+//
+// CPU0 side
+//
+
+int cpu1_is_running()
+{ return cpu1_running; }
+
+int cpu1_submit(int (*func)(void *arg), void *arg)
+{
+  unsigned int job;
+  
+  if (!cpu1_running)
+    return -1;
+  
+  job = cpu1_head;
+  
+  if ((job - cpu1_tail) >= CPU1_JOBS)
+    return -1;
+  
+  cpu1_jobs[job & (CPU1_JOBS - 1)].func = func;
+  cpu1_jobs[job & (CPU1_JOBS - 1)].arg = arg;
+  cpu1_jobs[job & (CPU1_JOBS - 1)].rtn = 0;
+  
+  DMB();
+  cpu1_head = job + 1;
+  SEV();
+  
+  return (int) job;
+}
+
+int cpu1_is_done(int job)
+{ return ((int) (cpu1_tail - (unsigned int) job) > 0); }
+
+int cpu1_wait(int job)
+{
+  while (!cpu1_is_done(job))
+    WFE();
+  
+  DMB();
+  return cpu1_jobs[job & (CPU1_JOBS - 1)].rtn;
+}
+
+void cpu1_join()
+{
+  while (cpu1_tail != cpu1_head)
+    WFE();
+  
+  DMB();
+  return;
+}
+
+int cpu1_start(int step)
+{
+  unsigned long long timeout;
+  
+  // NOTE: Might still be running from before a 'restart'
+  *RSTMGR_MPUMODRST |= 0x00000002;
+  
+  cpu1_head = 0;
+  cpu1_tail = 0;
+  cpu1_running = 0;
+  cpu1_parked[0] = 0;
+  
+  // NOTE: CPU1 starts with its caches off, so push everything it needs out to OCRAM
+  *SYSMGR_CPU1STARTADDR = (unsigned int) _startup;
+  alt_cache_system_clean((void*) &_start, (int) &_stack_end - (int) &_start);
+  DMB();
+  
+  *RSTMGR_MPUMODRST &= ~0x00000002;
+  
+  timeout = timer_ticks() + ((unsigned long long) timer_ticks_per_us() * 100000);
+  
+  while (!cpu1_running)
+  {
+    if (timer_ticks() > timeout)
+    {
+      *RSTMGR_MPUMODRST |= 0x00000002;
+      puts("ERROR: CPU1 did not start - jobs will run on CPU0");
+      return -1;
+    }
+  }
+  
+  return 0;
+}
+
+int cpu1_stop(int step)
+{
+  if (!cpu1_running)
+    return 0;
+  
+  cpu1_join();
+  
+  if (cpu1_submit(cpu1_park, NULL) >= 0)
+  {
+    while (1)
+    {
+      alt_cache_system_invalidate((void*) cpu1_parked, sizeof(cpu1_parked));
+      DMB();
+      
+      if (cpu1_parked[0])
+        break;
+      
+      WFE();
+    }
+  }
+  
+  *RSTMGR_MPUMODRST |= 0x00000002;
+  cpu1_running = 0;
+  
+  return 0;
+}
+
+//
+// CPU1 Terminal Commands
+//
+
+int cpu1_status(int argc, char** argv)
+{
+  if (cpu1_running)
+    printf("CPU1 running: %u jobs submitted, %u finished\n", cpu1_head, cpu1_tail);
+  else
+    puts("CPU1 not running");
+  
+  return 0;
+}
+
+
+BOOT_STEP(200, cpu1_start, "release cpu1 from reset as boot worker");
+BOOT_STEP(1100, cpu1_stop, "wait for cpu1 jobs and put cpu1 back in reset");
+
+TERMINAL_COMMAND("cpu1", cpu1_status, "Show CPU1 boot worker status");
@@ -0,0 +1,83 @@
+/*
+  CRC helpers (small nibble tables, suited to OCRAM)
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include "crc.h"
+
+//
+// CRC-16/CCITT-FALSE
+// - One 16 entry table, two lookups per byte
+//
+
+static const unsigned short crc16_table[16] =
+{
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+unsigned short crc16(unsigned short crc, const void *buf, int len)
+{
+  const unsigned char *ptr;
+  
+  ptr = (const unsigned char*) buf;
+  
+  while (len-- > 0)
+  {
+    crc = (crc << 4) ^ crc16_table[((crc >> 12) ^ (*ptr >> 4)) & 0x0F];
+    crc = (crc << 4) ^ crc16_table[((crc >> 12) ^ (*ptr & 0x0F)) & 0x0F];
+    ptr++;
+  }
+  
+  return crc;
+}
+
+//
+// CRC-32 (reflected, poly 0xEDB88320)
+// - One 16 entry table, two lookups per byte
+//
+
+static const unsigned int crc32_table[16] =
+{
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+unsigned int crc32(unsigned int crc, const void *buf, int len)
+{
+  const unsigned char *ptr;
+  
+  ptr = (const unsigned char*) buf;
+  crc = ~crc;
+  
+  while (len-- > 0)
+  {
+    crc = (crc >> 4) ^ crc32_table[(crc ^ *ptr) & 0x0F];
+    crc = (crc >> 4) ^ crc32_table[(crc ^ (*ptr >> 4)) & 0x0F];
+    ptr++;
+  }
+  
+  return ~crc;
+}
@@ -0,0 +1,353 @@
+/*
+  HPS DMA controller (ARM DMA-330 / PL330) channel API
+  
+  Channel programs are assembled here and started through the debug registers, so
+  no manager thread program is needed.
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include "alt_cache.h"
+#include "boot.h"
+#include "dma.h"
+
+#define RSTMGR_PER0MODRST ((volatile unsigned int*) 0xFFD05024)
+#define RSTMGR_DMA 0x00210000 // dma, dma_ocp
+
+#define DMA_BASE 0xFFDA1000 // Secure view
+#define DMA_DSR       ((volatile unsigned int*) (DMA_BASE + 0x000))
+#define DMA_CSR(ch)   ((volatile unsigned int*) (DMA_BASE + 0x100 + ((ch) * 8)))
+#define DMA_INTEN     ((volatile unsigned int*) (DMA_BASE + 0x020))
+#define DMA_INT_EVENT_RIS ((volatile unsigned int*) (DMA_BASE + 0x024))
+#define DMA_INTCLR    ((volatile unsigned int*) (DMA_BASE + 0x02C))
+#define DMA_FTR(ch)   ((volatile unsigned int*) (DMA_BASE + 0x040 + ((ch) * 4)))
+#define DMA_DBGSTATUS ((volatile unsigned int*) (DMA_BASE + 0xD00))
+#define DMA_DBGCMD    ((volatile unsigned int*) (DMA_BASE + 0xD04))
+#define DMA_DBGINST0  ((volatile unsigned int*) (DMA_BASE + 0xD08))
+#define DMA_DBGINST1  ((volatile unsigned int*) (DMA_BASE + 0xD0C))
+
+#define CSR_STATE 0x0000000F
+#define CSR_STOPPED 0
+#define CSR_FAULTING_COMPLETING 14
+#define CSR_FAULTING 15
+
+// Channel control: word transfers, incrementing addresses, secure privileged
+#define CCR_WORDS   0x00414105 // SAI, SS = 4 bytes, SP = 1, DAI, DS = 4 bytes, DP = 1
+#define CCR_BURST8  0x001C0070 // SB = DB = 8 beats (32 bytes, one cache line)
+
+#define DMA_BURST 32
+#define DMA_PROG_BYTES 128
+#define DMA_LINE 32
+
+#define DMB() __asm volatile("dmb;\n" : : : "memory")
+
+//
+// Channel state
+//
+
+unsigned char dma_prog[DMA_CHANNELS][DMA_PROG_BYTES] __attribute__((aligned(DMA_LINE)));
+
+struct
+{
+  void *dst;      // Invalidated when done, NULL for a data port
+  unsigned int bytes;
+  int busy;
+} dma_ch[DMA_CHANNELS];
+
+int dma_ready;
+
+//
+// Controller control
+// - The debug registers are one set for all channels, so both cores take turns
+//   (Peterson's lock, as exclusive loads need the MMU to be on)
+//
+
+volatile int dma_debug_want[2];
+volatile int dma_debug_turn;
+
+static int dma_cpu()
+{
+  unsigned int mpidr;
+  
+  __asm volatile("mrc p15, 0, %0, c0, c0, 5;\n" : "=r" (mpidr));
+  return mpidr & 1;
+}
+
+static void dma_debug(unsigned int inst0, unsigned int inst1)
+{
+  int cpu = dma_cpu();
+  
+  dma_debug_want[cpu] = 1;
+  dma_debug_turn = !cpu;
+  DMB();
+  
+  while (dma_debug_want[!cpu] && (dma_debug_turn == !cpu))
+    continue;
+  
+  DMB();
+  
+  while (*DMA_DBGSTATUS & 0x00000001)
+    continue;
+  
+  *DMA_DBGINST0 = inst0;
+  *DMA_DBGINST1 = inst1;
+  *DMA_DBGCMD = 0;
+  
+  // NOTE: Idle once the instruction has been taken by the channel or manager thread
+  while (*DMA_DBGSTATUS & 0x00000001)
+    continue;
+  
+  DMB();
+  dma_debug_want[cpu] = 0;
+}
+
+int dma_init(int step)
+{
+  int ch;
+  
+  *RSTMGR_PER0MODRST &= ~RSTMGR_DMA;
+  
+  for (ch = 0; ch < DMA_CHANNELS; ch++)
+    dma_ch[ch].busy = 0;
+  
+  // Event 'ch' marks the end of channel 'ch' (see dma_poll)
+  *DMA_INTEN = (1 << DMA_CHANNELS) - 1;
+  *DMA_INTCLR = (1 << DMA_CHANNELS) - 1;
+  
+  dma_ready = 1;
+  return 0;
+}
+
+int dma_uninit(int step)
+{
+  int ch;
+  
+  for (ch = 0; ch < DMA_CHANNELS; ch++)
+    if (dma_ch[ch].busy)
+      dma_kill(ch);
+  
+  dma_ready = 0;
+  *RSTMGR_PER0MODRST |= RSTMGR_DMA;
+  return 0;
+}
+
+int dma_available()
+{ return dma_ready; }
+
+//
+// Program assembly
+//
+
+typedef struct
+{
+  unsigned char *p;
+  int pos;
+} dma_asm_t;
+
+static void dma_asm_byte(dma_asm_t *a, unsigned int b)
+{ a->p[a->pos++] = b & 0xFF; }
+
+static void dma_asm_mov(dma_asm_t *a, int reg, unsigned int val) // DMAMOV SAR (0), CCR (1), DAR (2)
+{
+  dma_asm_byte(a, 0xBC);
+  dma_asm_byte(a, reg);
+  dma_asm_byte(a, val);
+  dma_asm_byte(a, val >> 8);
+  dma_asm_byte(a, val >> 16);
+  dma_asm_byte(a, val >> 24);
+}
+
+// Loop of 'count' (1 to 256) load/store pairs on loop counter 'lc', optionally inside an outer loop
+static void dma_asm_loop(dma_asm_t *a, int outer, unsigned int count, unsigned int dst_port)
+{
+  int outer_start = 0;
+  int start;
+  
+  if (outer > 0)
+  {
+    dma_asm_byte(a, 0x20);             // DMALP lc0
+    dma_asm_byte(a, outer - 1);
+    outer_start = a->pos;
+  }
+  
+  dma_asm_byte(a, (outer > 0) ? 0x22 : 0x20); // DMALP lc1/lc0
+  dma_asm_byte(a, count - 1);
+  start = a->pos;
+  
+  dma_asm_byte(a, 0x04);               // DMALD
+  
+  if (dst_port)
+    dma_asm_mov(a, 2, dst_port);       // NOTE: Back to the start of the port for each store
+  
+  dma_asm_byte(a, 0x08);               // DMAST
+  
+  dma_asm_byte(a, (outer > 0) ? 0x3C : 0x38); // DMALPEND lc1/lc0
+  dma_asm_byte(a, a->pos - 1 - start);
+  
+  if (outer > 0)
+  {
+    dma_asm_byte(a, 0x38);             // DMALPEND lc0
+    dma_asm_byte(a, a->pos - 1 - outer_start);
+  }
+}
+
+//
+// Copies
+//
+
+int dma_start(int ch, void *dst, const void *src, unsigned int bytes, int flags)
+{
+  dma_asm_t a;
+  unsigned int bursts;
+  unsigned int words;
+  unsigned int port;
+  unsigned int start;
+  unsigned int end;
+  
+  if (!dma_ready || (ch < 0) || (ch >= DMA_CHANNELS) || dma_ch[ch].busy || (bytes == 0) ||
+    (bytes > DMA_MAX_BYTES) || (bytes & 3) || ((unsigned int) dst & 3) || ((unsigned int) src & 3))
+  {
+    return -1;
+  }
+  
+  port = (flags & DMA_DST_PORT) ? (unsigned int) dst : 0;
+  bursts = bytes / DMA_BURST;
+  words = (bytes % DMA_BURST) >> 2;
+  
+  a.p = dma_prog[ch];
+  a.pos = 0;
+  
+  dma_asm_mov(&a, 0, (unsigned int) src);
+  dma_asm_mov(&a, 2, (unsigned int) dst);
+  dma_asm_mov(&a, 1, CCR_WORDS | CCR_BURST8);
+  
+  if (bursts >> 8)
+    dma_asm_loop(&a, bursts >> 8, 256, port);
+  
+  if (bursts & 0xFF)
+    dma_asm_loop(&a, 0, bursts & 0xFF, port);
+  
+  if (words)
+  {
+    dma_asm_mov(&a, 1, CCR_WORDS);
+    dma_asm_loop(&a, 0, words, port);
+  }
+  
+  dma_asm_byte(&a, 0x13);              // DMAWMB
+  dma_asm_byte(&a, 0x34);              // DMASEV ch
+  dma_asm_byte(&a, ch << 3);
+  dma_asm_byte(&a, 0x00);              // DMAEND
+  
+  // Program and source out to memory, nothing dirty left over the destination
+  alt_cache_system_clean(dma_prog[ch], DMA_PROG_BYTES);
+  
+  start = (unsigned int) src & ~(DMA_LINE - 1);
+  end = ((unsigned int) src + bytes + DMA_LINE - 1) & ~(DMA_LINE - 1);
+  alt_cache_system_clean((void*) start, end - start);
+  
+  dma_ch[ch].dst = (void*)0;
+  
+  if (!port)
+  {
+    start = (unsigned int) dst & ~(DMA_LINE - 1);
+    end = ((unsigned int) dst + bytes + DMA_LINE - 1) & ~(DMA_LINE - 1);
+    dma_ch[ch].dst = (void*) start;
+    dma_ch[ch].bytes = end - start;
+    alt_cache_system_purge(dma_ch[ch].dst, dma_ch[ch].bytes);
+  }
+  
+  dma_ch[ch].busy = 1;
+  *DMA_INTCLR = 1 << ch;
+  
+  // DMAGO from the manager thread
+  dma_debug((ch << 24) | (0xA0 << 16), (unsigned int) dma_prog[ch]);
+  return 0;
+}
+
+int dma_poll(int ch)
+{
+  unsigned int state;
+  
+  if ((ch < 0) || (ch >= DMA_CHANNELS) || !dma_ch[ch].busy)
+    return -1;
+  
+  state = *DMA_CSR(ch) & CSR_STATE;
+  
+  if ((state == CSR_FAULTING) || (state == CSR_FAULTING_COMPLETING))
+  {
+    dma_kill(ch);
+    return -2;
+  }
+  
+  // NOTE: The channel reads as stopped until the DMAGO is taken, so wait for its event
+  if ((*DMA_INT_EVENT_RIS & (1 << ch)) == 0)
+    return BOOT_BUSY;
+  
+  *DMA_INTCLR = 1 << ch;
+  
+  while ((*DMA_CSR(ch) & CSR_STATE) != CSR_STOPPED)
+    continue;
+  
+  // NOTE: Lines may have been fetched (speculatively) while the data came in
+  if (dma_ch[ch].dst)
+    alt_cache_system_invalidate(dma_ch[ch].dst, dma_ch[ch].bytes);
+  
+  dma_ch[ch].busy = 0;
+  return 0;
+}
+
+int dma_wait(int ch)
+{
+  int rtn;
+  
+  do
+  {
+    rtn = dma_poll(ch);
+  } while (rtn == BOOT_BUSY);
+  
+  return rtn;
+}
+
+void dma_kill(int ch)
+{
+  // DMAKILL on the channel thread
+  dma_debug((0x01 << 16) | (ch << 8) | 0x00000001, 0);
+  
+  while ((*DMA_CSR(ch) & CSR_STATE) != CSR_STOPPED)
+    continue;
+  
+  *DMA_INTCLR = 1 << ch;
+  dma_ch[ch].busy = 0;
+}
+
+int dma_memcpy(void *dst, const void *src, unsigned int bytes)
+{
+  if (dma_start(DMA_CH_MEMCPY, dst, src, bytes, 0))
+    return -1;
+  
+  return dma_wait(DMA_CH_MEMCPY);
+}
+
+BOOT_STEP(290, dma_init, "release dma-330 controller from reset");
+BOOT_STEP(1150, dma_uninit, "put dma-330 controller back in reset");
@@ -38,7 +38,7 @@ SOFTWARE.
 
 ALT_I2C_DEV_t i2c_dev;
 
-void i2c_init(int step)
+int i2c_init(int step)
 {
   ALT_STATUS_CODE status;
   ALT_I2C_MASTER_CONFIG_t cfg;
@@ -69,7 +69,7 @@ void i2c_init(int step)
   if (status != ALT_E_SUCCESS)
   { puts("ERROR: I2C Init FAILED"); }
   
-  return;
+  return status;
 }
 
 int i2c_receive(int argc, char** argv)
@@ -80,6 +80,7 @@ int i2c_receive(int argc, char** argv)
   unsigned int cnt;
   int x;
   char buf[256];
+  char *end;
   
   //
   // Parse Args
@@ -91,13 +92,15 @@ int i2c_receive(int argc, char** argv)
     return -1;
   }
 
-  if (sscanf(argv[1], "%u", &chip) != 1)
+  chip = strtou32(argv[1], &end, 0);
+  if ((end == argv[1]) || (*end != '\0'))
   {
     puts("ERROR: First argument must be an unsigned number for chip address");
     return -2;
   }
   
-  if (sscanf(argv[2], "%u", &cnt) != 1)
+  cnt = strtou32(argv[2], &end, 0);
+  if ((end == argv[2]) || (*end != '\0'))
   {
     puts("ERROR: Second argument must be an unsigned number for byte count");
     return -3;
@@ -154,6 +157,8 @@ int i2c_transmit(int argc, char** argv)
   unsigned int cnt;
   int x;
   char buf[256];
+  unsigned int data;
+  char *end;
   
   //
   // Parse Args
@@ -165,7 +170,8 @@ int i2c_transmit(int argc, char** argv)
     return -1;
   }
 
-  if (sscanf(argv[1], "%u", &chip) != 1)
+  chip = strtou32(argv[1], &end, 0);
+  if ((end == argv[1]) || (*end != '\0'))
   {
     puts("ERROR: First argument must be an unsigned number");
     return -2;
@@ -173,10 +179,13 @@ int i2c_transmit(int argc, char** argv)
   
   for (cnt = 0; cnt < (argc - 2); cnt++)
   {
-    if (cnt > 256)
+    if (cnt >= 256)
       break;
 
-    if (sscanf(argv[cnt+2], "%u", &(buf[cnt])) != 1)
+    data = strtou32(argv[cnt+2], &end, 0);
+    buf[cnt] = (char) data;
+    
+    if ((end == argv[cnt+2]) || (*end != '\0') || (data > 0xFF))
     {
       puts("ERROR: Byte argument must be an unsigned number");
       return -3;
@@ -221,7 +230,7 @@ int i2c_transmit(int argc, char** argv)
 }
 
 
-BOOT_STEP(310, i2c_init, "init i2c bus");
+BOOT_STEP_DEPS(310, i2c_init, "init i2c bus", clock_init, pinmux_init);
 
 TERMINAL_COMMAND("i2c-rx", i2c_receive, "{chip} {count}");
 TERMINAL_COMMAND("i2c-tx", i2c_transmit, "{chip} {byte} ...");
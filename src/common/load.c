@@ -0,0 +1,407 @@
+/*
+  Load data into memory over the stdio UART (XMODEM/YMODEM-1K or raw)
+  
+    load ymodem {address} {max bytes}  : XMODEM-CRC, XMODEM-1K or YMODEM (first file only)
+    load raw {address} {max bytes}     : 4 byte little endian length, then the data
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include <string.h>
+#include "simple_stdio.h"
+#include "terminal.h"
+#include "timer.h"
+#include "crc.h"
+
+#define SOH 0x01
+#define STX 0x02
+#define EOT 0x04
+#define ACK 0x06
+#define NAK 0x15
+#define CAN 0x18
+#define CTRL_C 0x03
+
+#define LOAD_BYTE_TIMEOUT 1000000   // usec within a block (or between raw bytes)
+#define LOAD_BLOCK_TIMEOUT 10000000 // usec between blocks once started
+#define LOAD_START_TRIES 60         // 'C' requests (one per second) before giving up
+#define LOAD_MAX_ERRORS 10          // Bad blocks in a row before cancelling
+
+#define LOAD_E_TIMEOUT -1
+#define LOAD_E_CANCEL -2
+#define LOAD_E_SIZE -3
+#define LOAD_E_SEQUENCE -4
+
+unsigned char load_blk[1024 + 4]; // Block number, its complement, data and CRC16
+
+unsigned long long load_start; // Timer value when the first data arrived
+
+void load_send(unsigned char c)
+{ write_raw((char*) &c, 1); }
+
+void load_cancel()
+{ write_raw("\x18\x18\x18\x18\x18", 5); }
+
+void load_purge()
+{ while (getchar_timeout(100000) >= 0); } // NOTE: Wait for the line to go quiet
+
+//
+// Receive one XMODEM/YMODEM block
+// - Returns data size (128 or 1024), 0 for EOT, or LOAD_E_TIMEOUT/LOAD_E_CANCEL
+//
+
+int load_recv_block(unsigned int timeout)
+{
+  int c;
+  int x;
+  int size;
+  unsigned short crc;
+  
+  c = getchar_timeout(timeout);
+  
+  if (c < 0)
+    return LOAD_E_TIMEOUT;
+  else if (c == EOT)
+    return 0;
+  else if (c == CAN)
+    return (getchar_timeout(LOAD_BYTE_TIMEOUT) == CAN) ? LOAD_E_CANCEL : LOAD_E_TIMEOUT;
+  else if (c == CTRL_C)
+    return LOAD_E_CANCEL;
+  else if (c == SOH)
+    size = 128;
+  else if (c == STX)
+    size = 1024;
+  else
+    return LOAD_E_TIMEOUT;
+  
+  for (x = 0; x < (size + 4); x++)
+  {
+    if ((c = getchar_timeout(LOAD_BYTE_TIMEOUT)) < 0)
+      return LOAD_E_TIMEOUT;
+    
+    load_blk[x] = (unsigned char) c;
+  }
+  
+  if (load_blk[0] != (unsigned char) ~load_blk[1])
+    return LOAD_E_TIMEOUT;
+  
+  crc = crc16(CRC16_XMODEM_INIT, &load_blk[2], size);
+  
+  if (crc != ((load_blk[size + 2] << 8) | load_blk[size + 3]))
+    return LOAD_E_TIMEOUT;
+  
+  return size;
+}
+
+//
+// XMODEM/YMODEM receiver
+// - YMODEM starts with block 0 (file name and size), XMODEM starts with block 1
+// - Returns bytes received (XMODEM includes the padding of the last block) or an error
+//
+
+#define LOAD_HEADER 0
+#define LOAD_DATA 1
+#define LOAD_END 2
+
+int load_ymodem(unsigned char *dst, unsigned int max)
+{
+  int state;
+  int rtn;
+  int errors;
+  int eot;
+  unsigned int expected;
+  unsigned int received;
+  unsigned int file_size;
+  unsigned int n;
+  char *ptr;
+  
+  state = LOAD_HEADER;
+  errors = 0;
+  eot = 0;
+  expected = 0;
+  received = 0;
+  file_size = 0;
+  
+  while (1)
+  {
+    if (state == LOAD_DATA)
+    {
+      rtn = load_recv_block(LOAD_BLOCK_TIMEOUT);
+    }
+    else
+    {
+      // NOTE: Ask for CRC mode until the sender starts (or sends the end of batch block)
+      load_send('C');
+      rtn = load_recv_block(LOAD_BYTE_TIMEOUT);
+      
+      if (rtn == LOAD_E_TIMEOUT)
+      {
+        if (state == LOAD_END)
+          return received; // NOTE: Some senders stop without the end of batch block
+        
+        if (++errors > LOAD_START_TRIES)
+          return LOAD_E_TIMEOUT;
+        
+        load_purge();
+        continue;
+      }
+    }
+    
+    if (rtn == LOAD_E_CANCEL)
+      return LOAD_E_CANCEL;
+    
+    if (rtn < 0)
+    {
+      if (++errors > LOAD_MAX_ERRORS)
+      {
+        load_cancel();
+        return LOAD_E_TIMEOUT;
+      }
+      
+      load_purge();
+      load_send(NAK);
+      continue;
+    }
+    
+    errors = 0;
+    
+    if (rtn == 0)
+    {
+      // NOTE: NAK the first EOT and ACK the second, as YMODEM senders expect
+      if (state != LOAD_DATA)
+        continue;
+      
+      if (!eot)
+      {
+        eot = 1;
+        load_send(NAK);
+        continue;
+      }
+      
+      load_send(ACK);
+      
+      if (file_size == 0)
+        return received; // NOTE: XMODEM, nothing else follows
+      
+      state = LOAD_END;
+      continue;
+    }
+    
+    if (state != LOAD_DATA)
+    {
+      if (load_blk[0] == 0)
+      {
+        // NOTE: Only the first file of a batch is loaded, cancel the rest
+        if ((state == LOAD_END) && (load_blk[2] != '\0'))
+        {
+          load_cancel();
+          return received;
+        }
+        
+        load_send(ACK);
+        
+        if (load_blk[2] == '\0')
+          return received; // NOTE: End of batch
+        
+        // NOTE: File name, then size in decimal
+        ptr = (char*) &load_blk[2];
+        ptr += strlen(ptr) + 1;
+        
+        while ((*ptr >= '0') && (*ptr <= '9'))
+          file_size = (file_size * 10) + (*ptr++ - '0');
+        
+        if (file_size > max)
+        {
+          load_cancel();
+          return LOAD_E_SIZE;
+        }
+        
+        state = LOAD_DATA;
+        expected = 1;
+        load_send('C');
+        continue;
+      }
+      
+      if ((state == LOAD_END) || (load_blk[0] != 1))
+      {
+        load_cancel();
+        return LOAD_E_SEQUENCE;
+      }
+      
+      state = LOAD_DATA; // NOTE: XMODEM, no header block
+      expected = 1;
+    }
+    
+    if (load_blk[0] == ((expected - 1) & 0xFF))
+    {
+      load_send(ACK); // NOTE: Our ACK was lost, sender repeated the block
+      continue;
+    }
+    
+    if (load_blk[0] != (expected & 0xFF))
+    {
+      load_cancel();
+      return LOAD_E_SEQUENCE;
+    }
+    
+    if (received == 0)
+      load_start = timer_ticks();
+    
+    n = rtn;
+    
+    if ((file_size != 0) && ((received + n) > file_size))
+      n = file_size - received;
+    
+    if ((received + n) > max)
+    {
+      load_cancel();
+      return LOAD_E_SIZE;
+    }
+    
+    memcpy(&dst[received], &load_blk[2], n);
+    received += n;
+    expected++;
+    
+    load_send(ACK);
+  }
+}
+
+//
+// Raw receiver - 4 byte little endian length, then the data
+//
+
+int load_raw(unsigned char *dst, unsigned int max)
+{
+  unsigned int len;
+  unsigned int x;
+  int c;
+  
+  // NOTE: Give the user time to start the sender
+  if ((c = getchar_timeout(LOAD_START_TRIES * LOAD_BYTE_TIMEOUT)) < 0)
+    return LOAD_E_TIMEOUT;
+  
+  load_start = timer_ticks();
+  len = (unsigned int) c;
+  
+  for (x = 1; x < 4; x++)
+  {
+    if ((c = getchar_timeout(LOAD_BYTE_TIMEOUT)) < 0)
+      return LOAD_E_TIMEOUT;
+    
+    len |= ((unsigned int) c) << (x * 8);
+  }
+  
+  if (len > max)
+  {
+    load_purge();
+    return LOAD_E_SIZE;
+  }
+  
+  for (x = 0; x < len; x++)
+  {
+    if ((c = getchar_timeout(LOAD_BYTE_TIMEOUT)) < 0)
+      return LOAD_E_TIMEOUT;
+    
+    dst[x] = (unsigned char) c;
+  }
+  
+  return len;
+}
+
+//
+// Load terminal command
+//
+
+int load_cmd(int argc, char** argv)
+{
+  unsigned int addr;
+  unsigned int max;
+  unsigned int usec;
+  unsigned int rate;
+  int rtn;
+  char *end;
+  
+  if (argc != 4)
+  {
+    puts("ERROR: Wrong number of arguments");
+    return -1;
+  }
+  
+  addr = strtou32(argv[2], &end, 0);
+  if ((end == argv[2]) || (*end != '\0'))
+  {
+    puts("ERROR: Second argument must be an unsigned number");
+    return -2;
+  }
+  
+  max = strtou32(argv[3], &end, 0);
+  if ((end == argv[3]) || (*end != '\0'))
+  {
+    puts("ERROR: Third argument must be an unsigned number");
+    return -3;
+  }
+  
+  load_start = 0;
+  
+  if (strcmp(argv[1], "ymodem") == 0)
+  {
+    puts("Start XMODEM/YMODEM send now (Ctrl-X to cancel)");
+    flush();
+    rtn = load_ymodem((unsigned char*) addr, max);
+  }
+  else if (strcmp(argv[1], "raw") == 0)
+  {
+    puts("Send length and data now");
+    flush();
+    rtn = load_raw((unsigned char*) addr, max);
+  }
+  else
+  {
+    puts("ERROR: First argument must be 'ymodem|raw'");
+    return -4;
+  }
+  
+  load_purge();
+  
+  if (rtn == LOAD_E_TIMEOUT)
+    puts("\nERROR: Timeout or too many errors");
+  else if (rtn == LOAD_E_CANCEL)
+    puts("\nERROR: Cancelled");
+  else if (rtn == LOAD_E_SIZE)
+    printf("\nERROR: Data does not fit in %u bytes\n", max);
+  else if (rtn == LOAD_E_SEQUENCE)
+    puts("\nERROR: Blocks out of sequence");
+  
+  if (rtn < 0)
+    return -5;
+  
+  usec = (load_start == 0) ? 0 : timer_ticks_to_us(timer_ticks() - load_start);
+  rate = (usec == 0) ? 0 : (unsigned int) (((unsigned long long) rtn * 1000000) / usec);
+  
+  printf("\nLoaded %u bytes to %08X in %u usec (%u bytes/sec)\n", rtn, addr, usec, rate);
+  printf("CRC32 = %08X\n", crc32(0, (void*) addr, rtn));
+  
+  return 0;
+}
+
+TERMINAL_COMMAND("load", load_cmd, "{ymodem|raw} {address} {max bytes}");
@@ -0,0 +1,198 @@
+/*
+  Deferred binary logging (see log.h)
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include "log.h"
+#include "boot.h"
+#include "timer.h"
+#include "terminal.h"
+#include "simple_stdio.h"
+#include <string.h>
+
+// NOTE: Retained, so the log of a failed boot can still be dumped after a warm restart
+BOOT_RETAINED log_entry_t log_ring[2][LOG_ENTRIES];
+BOOT_RETAINED volatile uint32_t log_count[2]; // Records ever written by each CPU
+
+#ifdef HOST_BUILD // NOTE: 'make host-test', one core and no interrupts
+
+static inline uint32_t log_cpu() { return 0; }
+static inline uint32_t log_irq_save() { return 0; }
+static inline void log_irq_restore(uint32_t cpsr) { return; }
+static inline void log_dmb() { return; }
+
+#else
+
+static inline uint32_t log_cpu()
+{
+  uint32_t mpidr;
+  __asm volatile("mrc p15, 0, %0, c0, c0, 5;\n" : "=r" (mpidr));
+  return mpidr & 0x1;
+}
+
+static inline uint32_t log_irq_save()
+{
+  uint32_t cpsr;
+  __asm volatile("mrs %0, cpsr;\ncpsid i;\n" : "=r" (cpsr) : : "memory");
+  return cpsr;
+}
+
+static inline void log_irq_restore(uint32_t cpsr)
+{ __asm volatile("msr cpsr_c, %0;\n" : : "r" (cpsr) : "memory"); }
+
+static inline void log_dmb()
+{ __asm volatile("dmb;\n" : : : "memory"); }
+
+#endif
+
+void log_record(uint32_t level, const char *fmt, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+  log_entry_t *entry;
+  unsigned long long ticks;
+  uint32_t cpu;
+  uint32_t cpsr;
+  uint32_t n;
+  
+  // NOTE: Keep an ISR from claiming the same slot
+  cpsr = log_irq_save();
+  
+  ticks = timer_ticks();
+  cpu = log_cpu();
+  n = log_count[cpu];
+  entry = &log_ring[cpu][n & (LOG_ENTRIES - 1)];
+  
+  entry->seq = 0;
+  entry->level = level;
+  entry->ticks_lo = (uint32_t) ticks;
+  entry->ticks_hi = (uint32_t) (ticks >> 32);
+  entry->fmt = fmt;
+  entry->arg[0] = a;
+  entry->arg[1] = b;
+  entry->arg[2] = c;
+  entry->arg[3] = d;
+  
+  log_dmb(); // NOTE: Entry must be complete before it is valid
+  
+  entry->seq = n + 1;
+  log_count[cpu] = n + 1;
+  
+  log_irq_restore(cpsr);
+}
+
+//
+// Terminal command to print the log, oldest first
+//
+
+static unsigned long long log_ticks(log_entry_t *entry)
+{
+  return ((unsigned long long) entry->ticks_hi << 32) | entry->ticks_lo;
+}
+
+int log_dump(int argc, char** argv)
+{
+  log_entry_t *entry[2];
+  uint32_t next[2];
+  uint32_t end[2];
+  uint32_t cpu;
+  unsigned int usec;
+  char level[2];
+  int raw;
+  
+  raw = 0;
+  
+  if (argc == 2)
+  {
+    if (strcmp(argv[1], "clear") == 0)
+    {
+      memset(log_ring, 0, sizeof(log_ring));
+      log_count[0] = 0;
+      log_count[1] = 0;
+      return 0;
+    }
+    else if (strcmp(argv[1], "raw") == 0)
+      raw = 1;
+    else
+    {
+      puts("ERROR: Invalid argument");
+      return -1;
+    }
+  }
+  else if (argc != 1)
+  {
+    puts("ERROR: Invalid number of arguments");
+    return -1;
+  }
+  
+  // NOTE: Anything logged while dumping is left for next time
+  for (cpu = 0; cpu < 2; cpu++)
+  {
+    end[cpu] = log_count[cpu];
+    next[cpu] = (end[cpu] > LOG_ENTRIES) ? (end[cpu] - LOG_ENTRIES) : 0;
+  }
+  
+  if (raw)
+    printf("T %u\n", timer_ticks_per_us());
+  
+  while ((next[0] < end[0]) || (next[1] < end[1]))
+  {
+    for (cpu = 0; cpu < 2; cpu++)
+      entry[cpu] = (next[cpu] < end[cpu]) ? &log_ring[cpu][next[cpu] & (LOG_ENTRIES - 1)] : (log_entry_t*)0;
+    
+    if (entry[0] == (log_entry_t*)0)
+      cpu = 1;
+    else if (entry[1] == (log_entry_t*)0)
+      cpu = 0;
+    else
+      cpu = (log_ticks(entry[1]) < log_ticks(entry[0])) ? 1 : 0;
+    
+    next[cpu]++;
+    
+    // NOTE: Skip a slot that has been reused (or is being written) since end[] was read
+    if ((entry[cpu]->seq != next[cpu]) || (entry[cpu]->fmt == (char*)0))
+      continue;
+    
+    if (raw)
+    {
+      printf("L %u %u %08x %08x %08x %08x %08x %08x %08x\n", cpu, entry[cpu]->level, 
+        entry[cpu]->ticks_hi, entry[cpu]->ticks_lo, (unsigned int) entry[cpu]->fmt, 
+        entry[cpu]->arg[0], entry[cpu]->arg[1], entry[cpu]->arg[2], entry[cpu]->arg[3]);
+      continue;
+    }
+    
+    usec = timer_ticks_to_us(log_ticks(entry[cpu]));
+    
+    // NOTE: stdio_format() has no %c
+    level[0] = "?EWID"[(entry[cpu]->level > 4) ? 0 : entry[cpu]->level];
+    level[1] = '\0';
+    
+    printf("[%-5u.%06u] %s%u: ", usec / 1000000, usec % 1000000, level, cpu);
+    printf((char*) entry[cpu]->fmt, entry[cpu]->arg[0], entry[cpu]->arg[1], entry[cpu]->arg[2], entry[cpu]->arg[3]);
+    puts("");
+  }
+  
+  return 0;
+}
+
+TERMINAL_COMMAND("log-dump", log_dump, "[raw | clear] (raw output is for src/tools/log_decode)");
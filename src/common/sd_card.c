@@ -31,6 +31,13 @@ SOFTWARE.
 #include "terminal.h"
 #include "boot.h"
 #include "simple_stdio.h"
+#include "cpu1.h"
+#include "log.h"
+#include "timer.h"
+#include "sd_dma.h"
+#include "dma.h"
+#include "crc.h"
+#include "alt_clock_manager.h"
 #include <string.h>
 
 //
@@ -41,8 +48,13 @@ ALT_SDMMC_CARD_INFO_t sd_card_info;
 ALT_SDMMC_CARD_MISC_t sd_card_misc_cfg;
 uint32_t sd_card_block_size;
 uint32_t sd_card_size;
+int sd_card_dma; // Reads go through the IDMAC (see sd_read())
+int sd_card_width;
+unsigned int sd_card_khz;
 
-void sd_card_init(int step)
+int sd_card_speed(); // Picks bus width and clock
+
+int sd_card_init(int step)
 {
   ALT_STATUS_CODE status;
 
@@ -67,19 +79,17 @@ void sd_card_init(int step)
     case ALT_SDMMC_CARD_TYPE_SDHC:
       break;
     default:
-      puts("INFO: Card type unknown");
+      LOG_INFO("SD card type unknown (%i)", sd_card_info.card_type);
       status = ALT_E_ERROR;
       break;
     }
   }
 
-  if (status == ALT_E_SUCCESS)
-  { status = alt_sdmmc_card_bus_width_set(&sd_card_info, ALT_SDMMC_BUS_WIDTH_4); }
-
   if (status == ALT_E_SUCCESS)
   {
-    alt_sdmmc_fifo_param_set((ALT_SDMMC_FIFO_NUM_ENTRIES >> 3) - 1,
-      (ALT_SDMMC_FIFO_NUM_ENTRIES >> 3), ALT_SDMMC_MULT_TRANS_TXMSIZE1);
+    // NOTE: DMA requests once a whole burst is in the FIFO, also the IDMAC burst size
+    //       (blocks shorter than one burst drop to single words, see sd_dma_start())
+    alt_sdmmc_fifo_param_set(SD_DMA_BURST_WORDS - 1, SD_DMA_BURST_WORDS, ALT_SDMMC_MULT_TRANS_TXMSIZE8);
   }
 
   if (status == ALT_E_SUCCESS)
@@ -92,11 +102,11 @@ void sd_card_init(int step)
     sd_card_size *= sd_card_block_size;
   }
 
-  //if (status == ALT_E_SUCCESS)
-  //{ status = alt_sdmmc_dma_enable(); }
+  if (status == ALT_E_SUCCESS)
+  { sd_card_dma = (sd_dma_init(sd_card_info.card_type == ALT_SDMMC_CARD_TYPE_SDHC) == 0); }
 
   if (status == ALT_E_SUCCESS)
-  { status = alt_sdmmc_card_clk_div_set(0x00000004); } // (200MHz SDMMC CLK) / 4 = 50 MHz / 8 = 6 MHz (Class 4 card or better)
+  { status = sd_card_speed(); }
   
   if (sd_card_block_size != 512)
   { printf("WARNING: SD Card with blocksize %i is not supported - yet\n", sd_card_block_size); }
@@ -104,27 +114,158 @@ void sd_card_init(int step)
   if (status != ALT_E_SUCCESS)
   { puts("ERROR: SD Card Init FAILED"); }
   
-  return;
+  return status;
 }
 
+//
+// RBF loading state, so a load can be done a chunk at a time
+// - Two buffers: the next chunk is read from the card (by DMA) while the current
+//   one is written to the FPGA manager
+// - The chunk size can be changed for one 'sd-rbf', up to SD_RBF_CHUNK_MAX
+// - The FPGA writes are done by the CPU, or handed to the DMA-330 (see dma.h) so the
+//   CPU is free for the whole load ('sd-rbf ... dma', or SD_RBF_FPGA_DMA)
+// - Other loads (i.e. 'default.rbf') always use SD_RBF_CHUNK and SD_RBF_FPGA_DMA
+//
+
+#ifndef SD_RBF_CHUNK_MAX
+#define SD_RBF_CHUNK_MAX (8 * 1024)
+#endif
+
+#ifndef SD_RBF_CHUNK
+#define SD_RBF_CHUNK SD_RBF_CHUNK_MAX
+#endif
+
+#ifndef SD_RBF_FPGA_DMA
+#define SD_RBF_FPGA_DMA 0
+#endif
+
+typedef struct
+{
+  int sector;              // Next sector to read
+  int bytes;               // Left to write to the FPGA
+  int unread;              // Left to read from the card (whole sectors)
+  int chunk;
+  int buf;                 // Buffer the read in flight goes to
+  int len;                 // Size of the read in flight, 0 if none
+  int dma;                 // Read in flight is still running
+  unsigned long long issued;
+  unsigned long long stalled; // When the FPGA side started waiting for it, 0 if not
+  int fpga_dma;            // FPGA writes by DMA
+  int writing;             // FPGA write by DMA still running
+  unsigned long long written;
+  
+  // Per phase times (see sd_rbf_report())
+  unsigned long long start;
+  unsigned long long sd_ticks;
+  unsigned long long wait_ticks;
+  unsigned long long fpga_ticks;
+  int total;
+} sd_rbf_t;
+
+unsigned int sd_rbf_buf[2][SD_RBF_CHUNK_MAX / 4] __attribute__((aligned(SD_DMA_ALIGN)));
+
+int sd_rbf_begin(sd_rbf_t *rbf, char *filename, int compressed, int chunk, int fpga_dma);
+int sd_rbf_feed(sd_rbf_t *rbf);
+void sd_rbf_abort(sd_rbf_t *rbf);
+void sd_rbf_report(sd_rbf_t *rbf);
 int sd_load_rbf(char *filename, int compressed);
+void sd_parts_warn();
+
+//
+// Default RBF Boot Step
+// - Loaded by CPU1 if it is running, otherwise a chunk at a time between later boot steps
+//
 
-void sd_card_default_rbf(int step)
+int sd_default_rbf_job = -1; // CPU1 job number while 'default.rbf' loads in the background
+sd_rbf_t sd_default_rbf;
+
+int sd_card_default_rbf_load(void *arg)
+{ return sd_load_rbf("default.rbf", 0); } // Note: default.rbf must be uncompressed
+
+int sd_card_default_rbf_poll(void *arg)
 {
   int rtn;
   
-  rtn = sd_load_rbf("default.rbf", 0); // Note: default.rbf must be uncompressed
+  if (sd_default_rbf_job >= 0)
+  {
+    if (!cpu1_is_done(sd_default_rbf_job))
+      return BOOT_BUSY;
+    
+    rtn = cpu1_wait(sd_default_rbf_job);
+    sd_default_rbf_job = -1;
+    return rtn;
+  }
+  
+  rtn = sd_rbf_feed(&sd_default_rbf);
+  
+  if (rtn > 0)
+    return BOOT_BUSY;
+  
+  return rtn;
+}
+
+void sd_card_default_rbf_report(int rtn, void *arg)
+{
+  // NOTE: A timeout drops the poll with the card read (and FPGA DMA) still running
+  if (rtn != 0)
+    sd_rbf_abort(&sd_default_rbf);
+  
+  // NOTE: The lookup may have run on CPU1, so it is reported from here
+  sd_parts_warn();
   
+  // NOTE: boot_step_end() reports the failure, this only adds what -1 means
   if (rtn == -1)
-    puts("ERROR: File 'default.rbf' not found");
-  else if (rtn != 0)
-    printf("ERROR: Load RBF Error Code (%i)\n", rtn);
+    puts("   File 'default.rbf' not found");
+}
+
+int sd_card_default_rbf(int step)
+{
+  int rtn;
+  
+  sd_default_rbf_job = cpu1_submit(sd_card_default_rbf_load, (void*)0);
+  
+  if (sd_default_rbf_job >= 0)
+  {
+    boot_async(sd_card_default_rbf_poll, sd_card_default_rbf_report, (void*)0, 1);
+    return 0;
+  }
+  
+  rtn = sd_rbf_begin(&sd_default_rbf, "default.rbf", 0, SD_RBF_CHUNK, SD_RBF_FPGA_DMA);
+  
+  if (rtn != 0)
+    sd_card_default_rbf_report(rtn, (void*)0);
+  else
+    boot_async(sd_card_default_rbf_poll, sd_card_default_rbf_report, (void*)0, 0);
+  
+  return rtn;
 }
 
+//
+// Wait for any background use of the card to finish (before using it from here)
+//
+
+void sd_card_wait()
+{ boot_async_wait_all(); }
+
 //
 // SD Helper Functions
 //
 
+// Read whole sectors - by DMA when the buffer allows it, otherwise by PIO
+int sd_read(void *dest, unsigned int sector, unsigned int bytes)
+{
+  if (sd_card_dma && (((unsigned int) dest & (SD_DMA_ALIGN - 1)) == 0) &&
+    ((bytes & 0x1FF) == 0) && (bytes <= SD_DMA_MAX_BYTES))
+  {
+    return sd_dma_read(dest, sector, bytes);
+  }
+  
+  if (alt_sdmmc_read(&sd_card_info, dest, (void*)(sector * 512), bytes) != ALT_E_SUCCESS)
+    return -1;
+  
+  return 0;
+}
+
 struct
 {
   struct
@@ -133,15 +274,21 @@ struct
     unsigned int start;
     unsigned int size;
   } p[4];
+  int no_mbr; // NOTE: Reported by sd_parts_warn(), as the lookup may run on CPU1
 } sd_parts_list;
 
+void sd_parts_warn()
+{
+  if (sd_parts_list.no_mbr)
+    puts("WARNING: No MBR Found: Assuming pimage section starts at offset 0");
+}
+
 int sd_load_parts()
 {
-  ALT_STATUS_CODE status;
   int x;
   int y = 0x1BE;
   unsigned int tmp;
-  char buf[512];
+  char buf[512] __attribute__((aligned(SD_DMA_ALIGN)));
 
   for (x = 0; x < 4; x++)
   {
@@ -149,15 +296,15 @@ int sd_load_parts()
     sd_parts_list.p[x].start = 0;
     sd_parts_list.p[x].size = 0;
   }
-    
-  status = alt_sdmmc_read(&sd_card_info, &buf, (void*)0, 512); // MBR
   
-  if (status != ALT_E_SUCCESS)
+  sd_parts_list.no_mbr = 0;
+    
+  if (sd_read(buf, 0, 512)) // MBR
     return -1;
     
   if ((buf[510] != 0x55) || (buf[511] != 0xAA))
   {
-    printf("WARNING: No MBR Found: Assuming pimage section starts at offset 0\n");
+    sd_parts_list.no_mbr = 1;
     sd_parts_list.p[0].type = 0xA2;
     sd_parts_list.p[0].start = 0;
     sd_parts_list.p[0].size = (1024 * 1024 * 1024);
@@ -188,11 +335,11 @@ int sd_load_parts()
 
 int sd_find_file(char *filename, int *sector, int *bytes)
 {
-  ALT_STATUS_CODE status;
   int x;
-  char buf[512];
-  char fname[64];
+  char buf[512] __attribute__((aligned(SD_DMA_ALIGN)));
   unsigned int fsize;
+  char *name;
+  int len;
   char *str;
   
   if (sd_load_parts())
@@ -202,35 +349,50 @@ int sd_find_file(char *filename, int *sector, int *bytes)
   {
     if (sd_parts_list.p[x].type == 0xA2)
     {
-      status = alt_sdmmc_read(&sd_card_info, buf, (void*)((sd_parts_list.p[x].start + 0x800) * 512), 512);
-
-      if (status == ALT_E_SUCCESS)
+      if (sd_read(buf, sd_parts_list.p[x].start + 0x800, 512) == 0)
       {
         if ((buf[0] == '>') && (buf[1] == ' ') && (buf[511] == '\0'))
         {
           *sector = (sd_parts_list.p[x].start + 0x801);
+          // NOTE: One "> {name} [{bytes}]" line per file (see 'make sdcard')
           str = buf;
-          while (*str != '\0')
+          while (*str == '>')
           {
-            if (sscanf(str, "> %s [%u]", fname, &fsize) == 2)
+            str++;
+            while (simple_isspace(*str))
+              str++;
+            
+            name = str;
+            while ((*str != '\0') && !simple_isspace(*str))
+              str++;
+            
+            len = str - name;
+            
+            while (simple_isspace(*str))
+              str++;
+            
+            if (*str != '[')
+              return -1;
+            
+            name[len] = '\0'; // NOTE: After the checks above, this can only be whitespace
+            fsize = strtou32(str + 1, &str, 10);
+            
+            if (*str != ']')
+              return -1;
+            
+            if (strcmp(name, filename) == 0)
             {
-              if (strcmp(fname, filename) == 0)
-              {
-                *bytes = fsize;
-                return 0;
-              }
-              
-              if (fsize & 0x1FF)
-                fsize = (fsize >> 9) + 1;
-              else
-                fsize = (fsize >> 9);
-
-              *sector += fsize;
+              *bytes = fsize;
+              return 0;
             }
+            
+            if (fsize & 0x1FF)
+              fsize = (fsize >> 9) + 1;
             else
-              return -1;
+              fsize = (fsize >> 9);
+
+            *sector += fsize;
             
-            str++;
             while ((*str != '\0') && (*str != '>'))
               str++;
           }
@@ -244,76 +406,475 @@ int sd_find_file(char *filename, int *sector, int *bytes)
   return -1;
 }
 
-int sd_load_rbf(char *filename, int compressed)
+//
+// Bus width and clock
+// - The SCR gives the bus widths, and whether CMD6 (SD 1.10 or later) can switch
+//   the card to high speed (50 MHz instead of 25 MHz)
+// - The card clock is the CIU clock (SDMMC clock / 4) divided by (2 * div), or
+//   the CIU clock itself for div 0
+// - The fastest divisor within the card's limit whose read matches the same read
+//   at the safe divisor wins, otherwise it stays at the safe divisor
+//
+
+#define SD_CLK_SAFE_DIV 4 // (200MHz SDMMC CLK) / 4 = 50 MHz / 8 = 6 MHz (Class 4 card or better)
+#define SD_PROBE_BYTES (4 * 1024)
+
+int sd_card_probe(void *buf, unsigned int sector, unsigned int *crc)
 {
-  ALT_STATUS_CODE status;
-  int sector;
-  int bytes;
-  int level;
+  if (sd_read(buf, sector, SD_PROBE_BYTES))
+    return -1;
+  
+  *crc = crc32(0, buf, SD_PROBE_BYTES);
+  return 0;
+}
+
+int sd_card_speed()
+{
+  unsigned char scr[SD_DMA_ALIGN] __attribute__((aligned(SD_DMA_ALIGN)));
+  unsigned char sw[64] __attribute__((aligned(SD_DMA_ALIGN)));
+  unsigned int buf[SD_PROBE_BYTES / 4] __attribute__((aligned(SD_DMA_ALIGN)));
+  unsigned int sector = 0;
+  unsigned int max = 25000000;
+  unsigned int ciu;
+  unsigned int freq;
+  unsigned int crc;
+  unsigned int ref;
+  int spec = 0;
+  int hs = 0;
+  int div;
   int x;
-  unsigned int buf[1024]; 
-  volatile unsigned int *fpgamgr_ctrl_0 = (volatile unsigned int*) 0xFFD03070;
-  volatile unsigned int *fpgamgr_ctrl_1= (volatile unsigned int*) 0xFFD03074;
-  volatile unsigned int *fpgamgr_ctrl_2 = (volatile unsigned int*) 0xFFD03078;
-  volatile unsigned int *fpgamgr_stat = (volatile unsigned int*) 0xFFD03080;
-  volatile unsigned int *fpgamgr_fsta = (volatile unsigned int*) 0xFFD03094;
-  volatile unsigned int *fpgamgr_imag = (volatile unsigned int*) 0xFFCFE400;
-  
-  if (sd_find_file(filename, &sector, &bytes))
+  
+  sd_card_width = 4;
+  
+  // SEND_SCR (ACMD51), MMC cards have none
+  if (sd_card_dma && (sd_card_info.card_type != ALT_SDMMC_CARD_TYPE_MMC) &&
+    (sd_dma_cmd(55, sd_card_info.rca << 16, (unsigned int*)0) == 0) && (sd_dma_read_block(51, 0, scr, 8) == 0))
+  {
+    spec = scr[0] & 0x0F;
+    
+    if ((scr[1] & 0x04) == 0)
+      sd_card_width = 1;
+  }
+  
+  if (alt_sdmmc_card_bus_width_set(&sd_card_info, (sd_card_width == 4) ? ALT_SDMMC_BUS_WIDTH_4 : ALT_SDMMC_BUS_WIDTH_1) != ALT_E_SUCCESS)
+    return ALT_E_ERROR;
+  
+  // SWITCH_FUNC (CMD6), check then set function 1 (high speed) of group 1
+  if ((spec >= 1) && (sd_dma_read_block(6, 0x00FFFFF1, sw, 64) == 0) && (sw[13] & 0x02) &&
+    (sd_dma_read_block(6, 0x80FFFFF1, sw, 64) == 0) && ((sw[16] & 0x0F) == 1))
+  {
+    hs = 1;
+    max = 50000000;
+  }
+  
+  // CSD TRAN_SPEED (as read by hwlib), if it looks sane
+  if ((sd_card_info.xfer_speed >= 400000) && (sd_card_info.xfer_speed < max) && !hs)
+    max = sd_card_info.xfer_speed;
+  
+  if ((alt_clk_freq_get(ALT_CLK_SDMMC, &ciu) != ALT_E_SUCCESS) || (ciu == 0))
+    ciu = 200000000;
+  
+  ciu /= 4;
+  
+  // Reference read at the safe clock, from the preloader image if there is one
+  div = SD_CLK_SAFE_DIV;
+  
+  if (alt_sdmmc_card_clk_div_set(div) != ALT_E_SUCCESS)
+    return ALT_E_ERROR;
+  
+  if (sd_load_parts() == 0)
+  {
+    for (x = 0; x < 4; x++)
+    {
+      if (sd_parts_list.p[x].type == 0xA2)
+      {
+        sector = sd_parts_list.p[x].start;
+        break;
+      }
+    }
+    
+    sd_parts_warn();
+  }
+  
+  if (sd_card_probe(buf, sector, &ref) == 0)
+  {
+    for (x = 0; x < SD_CLK_SAFE_DIV; x++)
+    {
+      freq = (x == 0) ? ciu : (ciu / (2 * x));
+      
+      if (freq > max)
+        continue;
+      
+      if ((alt_sdmmc_card_clk_div_set(x) == ALT_E_SUCCESS) && (sd_card_probe(buf, sector, &crc) == 0) && (crc == ref))
+      {
+        div = x;
+        break;
+      }
+      
+      LOG_INFO("SD card read-back failed at %u kHz", freq / 1000);
+    }
+  }
+  
+  if ((div == SD_CLK_SAFE_DIV) && (alt_sdmmc_card_clk_div_set(div) != ALT_E_SUCCESS))
+    return ALT_E_ERROR;
+  
+  sd_card_khz = ((div == 0) ? ciu : (ciu / (2 * div))) / 1000;
+  
+  printf("SD card: %i bit bus at %u kHz%s\n", sd_card_width, sd_card_khz, hs ? " (high speed)" : "");
+  return ALT_E_SUCCESS;
+}
+
+#define FPGAMGR_CTRL_0 ((volatile unsigned int*) 0xFFD03070)
+#define FPGAMGR_CTRL_1 ((volatile unsigned int*) 0xFFD03074)
+#define FPGAMGR_CTRL_2 ((volatile unsigned int*) 0xFFD03078)
+#define FPGAMGR_STAT ((volatile unsigned int*) 0xFFD03080)
+#define FPGAMGR_FSTA ((volatile unsigned int*) 0xFFD03094)
+#define FPGAMGR_IMAG ((volatile unsigned int*) 0xFFCFE400)
+
+//
+// Start the read of the next chunk into the other buffer
+// - By DMA it is left running, otherwise it is done here
+//
+
+int sd_rbf_read(sd_rbf_t *rbf)
+{
+  rbf->len = (rbf->unread < rbf->chunk) ? rbf->unread : rbf->chunk;
+  rbf->buf ^= 1;
+  rbf->issued = timer_ticks();
+  rbf->dma = 0;
+  
+  if (rbf->len == 0)
+    return 0;
+  
+  if (sd_card_dma)
+  {
+    if (sd_dma_read_start(sd_rbf_buf[rbf->buf], rbf->len, rbf->sector, rbf->len))
+      return -2;
+    
+    rbf->dma = 1;
+  }
+  else
+  {
+    if (sd_read(sd_rbf_buf[rbf->buf], rbf->sector, rbf->len))
+      return -2;
+    
+    rbf->sd_ticks += timer_ticks() - rbf->issued;
+    rbf->wait_ticks += timer_ticks() - rbf->issued;
+  }
+  
+  rbf->sector += (rbf->len >> 9);
+  rbf->unread -= rbf->len;
+  return 0;
+}
+
+int sd_rbf_begin(sd_rbf_t *rbf, char *filename, int compressed, int chunk, int fpga_dma)
+{
+  if (sd_find_file(filename, &(rbf->sector), &(rbf->bytes)))
     return -1;
 
-  *fpgamgr_ctrl_0 = 0x00000106;
-  *fpgamgr_ctrl_1 = 0x00000000;
+  rbf->unread = (rbf->bytes + 511) & ~511;
+  rbf->chunk = chunk;
+  rbf->buf = 1;
+  rbf->len = 0;
+  rbf->dma = 0;
+  rbf->stalled = 0;
+  rbf->fpga_dma = fpga_dma && dma_available();
+  rbf->writing = 0;
+  rbf->start = timer_ticks();
+  rbf->sd_ticks = 0;
+  rbf->wait_ticks = 0;
+  rbf->fpga_ticks = 0;
+  rbf->total = rbf->bytes;
+  
+  if ((rbf->chunk < 512) || (rbf->chunk > SD_RBF_CHUNK_MAX) || (rbf->chunk & 511))
+    rbf->chunk = SD_RBF_CHUNK_MAX;
+  
+  *FPGAMGR_CTRL_0 = 0x00000106;
+  *FPGAMGR_CTRL_1 = 0x00000000;
   
   if (compressed)
-    *fpgamgr_ctrl_2 = 0x01030001; // For Compressed RBFs
+    *FPGAMGR_CTRL_2 = 0x01030001; // For Compressed RBFs
   else
-    *fpgamgr_ctrl_2 = 0x01000001; // For Uncompressed RBFs
+    *FPGAMGR_CTRL_2 = 0x01000001; // For Uncompressed RBFs
   
-  *fpgamgr_ctrl_0 = 0x00000006;
-  while ((*fpgamgr_stat & 0x0000000E) != 0) ;
-  *fpgamgr_ctrl_0 = 0x00000106;  
-  while ((*fpgamgr_stat & 0x000000A0) != 0x00000080) ;
+  *FPGAMGR_CTRL_0 = 0x00000006;
+  while ((*FPGAMGR_STAT & 0x0000000E) != 0)
+    if (boot_step_expired())
+      return -4;
   
-  while (bytes > 0)
+  *FPGAMGR_CTRL_0 = 0x00000106;  
+  while ((*FPGAMGR_STAT & 0x000000A0) != 0x00000080)
+    if (boot_step_expired())
+      return -4;
+  
+  return sd_rbf_read(rbf);
+}
+
+//
+// Write 'bytes' (rounded up to words) to the FPGA manager image port
+// - The burst writer reads the FIFO level once, then fills all of the free space with
+//   8 word STM bursts into the image data window (and single words for the rest)
+// - The word writer is the original one word at a time loop, kept for 'sd-rbf-bench'
+//
+
+#define FPGAMGR_FIFO_WORDS 64
+
+int sd_rbf_burst = 1;
+
+static inline void sd_rbf_write8(unsigned int *buf)
+{
+#ifdef __arm__
+  __asm volatile(
+    "ldmia %0, {r3-r10};\n"
+    "stmia %1, {r3-r10};\n"
+    : : "r" (buf), "r" (FPGAMGR_IMAG) : "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "memory");
+#else
+  int x;
+  
+  for (x = 0; x < 8; x++)
+    FPGAMGR_IMAG[x] = buf[x];
+#endif
+}
+
+int sd_rbf_write_words(unsigned int *buf, int words)
+{
+  int level;
+  int x;
+  
+  level = *FPGAMGR_FSTA & 0xFF;
+  
+  for (x = 0; x < words; x++)
   {
-    status = alt_sdmmc_read(&sd_card_info, (char*)buf, (void*)(sector * 512), (4 * 1024));
+    while (level > 63) 
+      level = *FPGAMGR_FSTA & 0xFF;
+    
+    *FPGAMGR_IMAG = buf[x];
+    level++;
+  }
+  
+  return 0;
+}
 
-    if (status != ALT_E_SUCCESS)
-      return -2;
+int sd_rbf_write(unsigned int *buf, int bytes)
+{
+  int words;
+  int space;
+  
+  words = (bytes + 3) >> 2;
+  
+  if (!sd_rbf_burst)
+    sd_rbf_write_words(buf, words);
+  
+  while (sd_rbf_burst && (words > 0))
+  {
+    space = FPGAMGR_FIFO_WORDS - (*FPGAMGR_FSTA & 0xFF);
+    
+    if (space > words)
+      space = words;
+    
+    words -= space;
+    
+    for (; space >= 8; space -= 8)
+    {
+      sd_rbf_write8(buf);
+      buf += 8;
+    }
+    
+    for (; space > 0; space--)
+      *FPGAMGR_IMAG = *buf++;
+  }
+  
+  if (*FPGAMGR_STAT & 0x00000020)
+    return -3;
+  
+  return 0;
+}
+
+//
+// Load the next chunk of the RBF - Returns 1 if there is more to load, 0 when done
+// - Also returns 1 without doing anything while the card read is still running
+//
 
-    sector += 8;
+int sd_rbf_feed(sd_rbf_t *rbf)
+{
+  unsigned long long now;
+  int rtn;
+  int cur;
+  int len;
+  
+  if (rbf->writing)
+  {
+    rtn = dma_poll(DMA_CH_FPGAMGR);
     
-    level = *fpgamgr_fsta & 0xFF;
+    if (rtn == BOOT_BUSY)
+      return 1;
     
-    for (x = 0; x < (1024); x++)
+    rbf->fpga_ticks += timer_ticks() - rbf->written; // NOTE: Upper bound, like the card reads
+    rbf->writing = 0;
+    
+    if (rtn != 0)
+    {
+      sd_rbf_abort(rbf);
+      return -5;
+    }
+    
+    if (*FPGAMGR_STAT & 0x00000020)
+    {
+      sd_rbf_abort(rbf);
+      return -3;
+    }
+  }
+  
+  if (rbf->bytes > 0)
+  {
+    if (rbf->dma)
     {
-      while (level > 63) 
-        level = *fpgamgr_fsta & 0xFF;
+      rtn = sd_dma_read_poll();
+      now = timer_ticks();
       
-      *fpgamgr_imag = buf[x];
- 
-      level++;
-      bytes -= 4;
+      if (rtn == BOOT_BUSY)
+      {
+        if (rbf->stalled == 0)
+          rbf->stalled = now; // NOTE: The FPGA side is waiting for the card from here
+        
+        return 1;
+      }
       
-      if (bytes <= 0)
-        break;
+      if (rbf->stalled != 0)
+        rbf->wait_ticks += now - rbf->stalled;
+      
+      rbf->sd_ticks += now - rbf->issued; // NOTE: Upper bound, the end is when it was seen
+      rbf->stalled = 0;
+      rbf->dma = 0;
+      
+      if (rtn != 0)
+        return -2;
     }
     
-    if (*fpgamgr_stat & 0x00000020)
-      return -3;
+    // Next read goes out before this chunk is written
+    cur = rbf->buf;
+    len = (rbf->bytes < rbf->len) ? rbf->bytes : rbf->len;
+    
+    rtn = sd_rbf_read(rbf);
+    
+    if (rtn != 0)
+      return rtn;
+    
+    if (rbf->fpga_dma)
+    {
+      if (dma_start(DMA_CH_FPGAMGR, (void*) FPGAMGR_IMAG, sd_rbf_buf[cur], (len + 3) & ~3, DMA_DST_PORT))
+      {
+        sd_rbf_abort(rbf);
+        return -5;
+      }
+      
+      rbf->written = timer_ticks();
+      rbf->writing = 1;
+      rbf->bytes -= len;
+      return 1; // NOTE: Finished (and checked) on the next call
+    }
+    
+    now = timer_ticks();
+    rtn = sd_rbf_write(sd_rbf_buf[cur], len);
+    rbf->fpga_ticks += timer_ticks() - now;
+    rbf->bytes -= len;
+    
+    if (rtn != 0)
+    {
+      sd_rbf_abort(rbf);
+      return rtn;
+    }
+    
+    if (rbf->bytes > 0)
+      return 1;
   }
   
-  while (*fpgamgr_stat & 0x00000080) ;
-  while ((*fpgamgr_stat & 0x00000004) == 0) ;
+  while (*FPGAMGR_STAT & 0x00000080)
+    if (boot_step_expired())
+      return -4;
+  
+  while ((*FPGAMGR_STAT & 0x00000004) == 0)
+    if (boot_step_expired())
+      return -4;
   
-  *fpgamgr_ctrl_0 = 0x00000107;
-  *fpgamgr_ctrl_1 = 0x01000001;
-  *fpgamgr_ctrl_2 = 0x01000000;
+  *FPGAMGR_CTRL_0 = 0x00000107;
+  *FPGAMGR_CTRL_1 = 0x01000001;
+  *FPGAMGR_CTRL_2 = 0x01000000;
     
   return 0;
 }
 
+// Stop early - lets a read that is still running finish, since the card is shared
+void sd_rbf_abort(sd_rbf_t *rbf)
+{
+  if (rbf->writing)
+  {
+    dma_kill(DMA_CH_FPGAMGR);
+    rbf->writing = 0;
+  }
+  
+  if (rbf->dma)
+  {
+    while (sd_dma_read_poll() == BOOT_BUSY)
+      continue;
+    
+    rbf->dma = 0;
+  }
+}
+
+//
+// Per phase throughput of a finished load
+// - With DMA the card and FPGA phases overlap, so the total should be close to the
+//   slower of the two rather than their sum
+//
+
+unsigned int sd_rbf_rate(int bytes, unsigned long long ticks) // MB/s * 100
+{
+  unsigned int us;
+  
+  us = timer_ticks_to_us(ticks);
+  return (unsigned int) (((unsigned long long) bytes * 100) / ((us == 0) ? 1 : us));
+}
+
+void sd_rbf_report(sd_rbf_t *rbf)
+{
+  unsigned long long total;
+  unsigned int rate;
+  
+  total = timer_ticks() - rbf->start;
+  
+  printf("   %i bytes, %i byte chunks, card by %s, FPGA by %s\n", rbf->total, rbf->chunk,
+    sd_card_dma ? "DMA" : "PIO", rbf->fpga_dma ? "DMA" : "CPU");
+  
+  rate = sd_rbf_rate(rbf->total, rbf->sd_ticks);
+  printf("   sd    : %-9u us %-4u.%02u MB/s (FPGA waited %u us)\n", timer_ticks_to_us(rbf->sd_ticks),
+    rate / 100, rate % 100, timer_ticks_to_us(rbf->wait_ticks));
+  
+  rate = sd_rbf_rate(rbf->total, rbf->fpga_ticks);
+  printf("   fpga  : %-9u us %-4u.%02u MB/s\n", timer_ticks_to_us(rbf->fpga_ticks), rate / 100, rate % 100);
+  
+  rate = sd_rbf_rate(rbf->total, total);
+  printf("   total : %-9u us %-4u.%02u MB/s\n", timer_ticks_to_us(total), rate / 100, rate % 100);
+}
+
+int sd_load_rbf(char *filename, int compressed)
+{
+  sd_rbf_t rbf;
+  int rtn;
+  
+  rtn = sd_rbf_begin(&rbf, filename, compressed, SD_RBF_CHUNK, SD_RBF_FPGA_DMA);
+  
+  if (rtn != 0)
+    return rtn;
+  
+  do
+  {
+    rtn = sd_rbf_feed(&rbf);
+  } while (rtn > 0);
+  
+  return rtn;
+}
+
 
 //
 // SD Card Terminal Commands
@@ -323,12 +884,16 @@ int sd_parts(int argc, char** argv)
 {
   int x;
   
+  sd_card_wait();
+  
   if (sd_load_parts())
   {
     puts("ERROR: Unable to parse MBR");
     return -1;
   }
   
+  sd_parts_warn();
+  
   for (x = 0; x < 4; x++)
   {
     printf("---\nPartition # %i:\n", (x + 1));
@@ -342,9 +907,10 @@ int sd_parts(int argc, char** argv)
 
 int sd_files(int argc, char** argv)
 {
-  ALT_STATUS_CODE status;
   int x;
-  char buf[512];
+  char buf[512] __attribute__((aligned(SD_DMA_ALIGN)));
+  
+  sd_card_wait();
   
   if (sd_load_parts())
   {
@@ -352,13 +918,13 @@ int sd_files(int argc, char** argv)
     return -1;
   }
   
+  sd_parts_warn();
+  
   for (x = 0; x < 4; x++)
   {
     if (sd_parts_list.p[x].type == 0xA2)
     {
-      status = alt_sdmmc_read(&sd_card_info, buf, (void*)((sd_parts_list.p[x].start + 0x800) * 512), 512);
-
-      if (status == ALT_E_SUCCESS)
+      if (sd_read(buf, sd_parts_list.p[x].start + 0x800, 512) == 0)
       {
         if ((buf[0] == '>') && (buf[1] == ' ') && (buf[511] == '\0'))
         {
@@ -377,13 +943,15 @@ int sd_files(int argc, char** argv)
 
 int sd_dump(int argc, char** argv)
 {
-  ALT_STATUS_CODE status;
   int sector;
   int bytes;
   int x;
   int offset;
   char estr[17];
-  char buf[512];
+  char buf[512] __attribute__((aligned(SD_DMA_ALIGN)));
+  char *end;
+  
+  sd_card_wait();
   
   if (argc == 2)
   {
@@ -395,13 +963,15 @@ int sd_dump(int argc, char** argv)
   }
   else if (argc == 3)
   {  
-    if (sscanf(argv[1], "%i", &sector) != 1)
+    sector = strtos32(argv[1], &end, 0);
+    if ((end == argv[1]) || (*end != '\0'))
     {
       printf("ERROR: Argument 1 must be a number");
       return -2;
     }
 
-    if (sscanf(argv[2], "%i", &bytes) != 1)
+    bytes = strtos32(argv[2], &end, 0);
+    if ((end == argv[2]) || (*end != '\0'))
     {
       printf("ERROR: Argument 2 must be a number");
       return -3;
@@ -418,10 +988,7 @@ int sd_dump(int argc, char** argv)
   printf(" %08X : ", offset);
   while (bytes > 0)
   {
-    status = alt_sdmmc_read(&sd_card_info, buf, (void*)(sector * 512), 512);
-    sector++;
-    
-    if (status == ALT_E_SUCCESS)
+    if (sd_read(buf, sector++, 512) == 0)
     {
       for (x = 0; (x < 512) && (bytes > 0); x++)
       {
@@ -437,7 +1004,12 @@ int sd_dump(int argc, char** argv)
         offset++;
   
         if ((offset & 0xF) == 0)
+        {
           printf(" | %s |\n %08X : ", estr, offset);
+          
+          if (ctrlc())
+            bytes = 0; // NOTE: Stop at the end of a line
+        }
       }
     }
     else
@@ -466,14 +1038,42 @@ int sd_dump(int argc, char** argv)
 
 int sd_rbf(int argc, char** argv)
 {
+  sd_rbf_t rbf;
   int rtn;
   int compressed = 0;
+  int chunk = SD_RBF_CHUNK;
+  int fpga_dma = SD_RBF_FPGA_DMA;
+  unsigned int num;
+  char *end;
+  int x;
   
-  if (argc != 3)
+  sd_card_wait();
+  
+  if ((argc < 3) || (argc > 5))
   {
     puts("ERROR: Wrong number of arguments");
     return -2;
   }
+  
+  // NOTE: Options only apply to this load
+  for (x = 3; x < argc; x++)
+  {
+    if (strcmp(argv[x], "dma") == 0)
+      fpga_dma = 1;
+    else if (strcmp(argv[x], "cpu") == 0)
+      fpga_dma = 0;
+    else
+    {
+      num = strtou32(argv[x], &end, 0);
+      if ((end == argv[x]) || (*end != '\0') || (num < 512) || (num > SD_RBF_CHUNK_MAX) || (num & 511))
+      {
+        printf("ERROR: Chunk must be a multiple of 512, up to %i\n", SD_RBF_CHUNK_MAX);
+        return -4;
+      }
+      
+      chunk = num;
+    }
+  }
 
   if (strcmp(argv[2], "compressed") == 0)
     compressed = 1;
@@ -483,25 +1083,227 @@ int sd_rbf(int argc, char** argv)
     return -1;
   }
   
-  puts("Loading file...\n");
+  puts("Loading file... (Ctrl-C to stop)\n");
   flush();
   
-  rtn = sd_load_rbf(argv[1], compressed);
+  // NOTE: Same as sd_load_rbf(), but checks for Ctrl-C between chunks
+  rtn = sd_rbf_begin(&rbf, argv[1], compressed, chunk, fpga_dma);
+  
+  if (rtn == 0)
+  {
+    do
+    {
+      rtn = sd_rbf_feed(&rbf);
+      
+      if ((rtn > 0) && ctrlc())
+      {
+        sd_rbf_abort(&rbf);
+        puts("ERROR: Stopped, FPGA is not configured");
+        return -3;
+      }
+    } while (rtn > 0);
+  }
 
   if (rtn == 0)
+  {
     puts("   SUCCESS");
+    sd_rbf_report(&rbf);
+  }
   else
     printf("ERROR: Error Code (%i)\n", rtn);
     
   return 0;
 }
 
+//
+// Word vs burst FPGA image writes
+// - Loads the RBF twice by CPU, once with each writer, and compares the time spent
+//   writing (the card reads overlap and are not counted)
+//
+
+int sd_rbf_bench(int argc, char** argv)
+{
+  sd_rbf_t rbf;
+  unsigned int us;
+  unsigned int rate;
+  int compressed = 0;
+  int burst;
+  int rtn = 0;
+  int x;
+  
+  sd_card_wait();
+  
+  if (argc != 3)
+  {
+    puts("ERROR: Wrong number of arguments");
+    return -2;
+  }
+  
+  if (strcmp(argv[2], "compressed") == 0)
+    compressed = 1;
+  else if (strcmp(argv[2], "uncompressed"))
+  {
+    printf("ERROR: Bad 'un/compressed' argument\n");
+    return -1;
+  }
+  
+  burst = sd_rbf_burst;
+  
+  puts("Loading file twice... (Ctrl-C to stop)\n");
+  flush();
+  
+  for (x = 0; (x < 2) && (rtn == 0); x++)
+  {
+    sd_rbf_burst = x;
+    rtn = sd_rbf_begin(&rbf, argv[1], compressed, SD_RBF_CHUNK, 0);
+    
+    if (rtn == 0)
+    {
+      do
+      {
+        rtn = sd_rbf_feed(&rbf);
+        
+        if ((rtn > 0) && ctrlc())
+        {
+          sd_rbf_abort(&rbf);
+          rtn = -4;
+        }
+      } while (rtn > 0);
+    }
+    
+    if (rtn != 0)
+      break;
+    
+    us = timer_ticks_to_us(rbf.fpga_ticks);
+    rate = (unsigned int) (((unsigned long long) ((rbf.total + 3) >> 2) * 100) / ((us == 0) ? 1 : us));
+    printf("   %s : %-9u words %-9u us %-4u.%02u words/us\n", x ? "burst" : "word ",
+      (rbf.total + 3) >> 2, us, rate / 100, rate % 100);
+  }
+  
+  sd_rbf_burst = burst;
+  
+  if (rtn != 0)
+    printf("ERROR: Error Code (%i), FPGA is not configured\n", rtn);
+  
+  return 0;
+}
+
+//
+// PIO vs DMA read throughput
+// - PIO reads 4kB per command (the size of the buffer), DMA up to SD_DMA_MAX_BYTES per
+//   command with the descriptors wrapping around the same buffer
+//
+
+int sd_bench_run(unsigned int *buf, int dma, unsigned int sector, unsigned int bytes)
+{
+  unsigned long long start;
+  unsigned int len;
+  unsigned int us;
+  int rtn;
+  
+  start = timer_ticks();
+  
+  while (bytes > 0)
+  {
+    len = dma ? SD_DMA_MAX_BYTES : (4 * 1024);
+    
+    if (len > bytes)
+      len = bytes;
+    
+    if (dma)
+    {
+      if (sd_dma_read_start(buf, (4 * 1024), sector, len))
+        return -1;
+      
+      while ((rtn = sd_dma_read_poll()) == BOOT_BUSY)
+        continue; // NOTE: CPU is free for other work here
+      
+      if (rtn != 0)
+        return -1;
+    }
+    else if (alt_sdmmc_read(&sd_card_info, buf, (void*)(sector * 512), len) != ALT_E_SUCCESS)
+    {
+      return -1;
+    }
+    
+    sector += (len >> 9);
+    bytes -= len;
+  }
+  
+  us = timer_ticks_to_us(timer_ticks() - start);
+  return (us == 0) ? 1 : us;
+}
+
+int sd_bench(int argc, char** argv)
+{
+  static const unsigned int sizes[] = {4 * 1024, 64 * 1024, 1024 * 1024};
+  unsigned int buf[1024] __attribute__((aligned(SD_DMA_ALIGN)));
+  unsigned int sector = 0;
+  int pio;
+  int dma;
+  int x;
+  char *end;
+  
+  sd_card_wait();
+  
+  if (argc > 2)
+  {
+    puts("ERROR: Wrong number of arguments");
+    return -1;
+  }
+  
+  if (argc == 2)
+  {
+    sector = strtou32(argv[1], &end, 0);
+    if ((end == argv[1]) || (*end != '\0'))
+    {
+      puts("ERROR: Argument 1 must be a number");
+      return -2;
+    }
+  }
+  
+  if (!sd_card_dma)
+    puts("WARNING: DMA is not enabled, both columns are PIO");
+  
+  printf("\nSD card: %i bit bus at %u kHz\n", sd_card_width, sd_card_khz);
+  puts("\n     size :  PIO MB/s  DMA MB/s");
+  
+  for (x = 0; x < (sizeof(sizes) / sizeof(sizes[0])); x++)
+  {
+    pio = sd_bench_run(buf, 0, sector, sizes[x]);
+    dma = sd_bench_run(buf, sd_card_dma, sector, sizes[x]);
+    
+    if ((pio < 0) || (dma < 0))
+    {
+      puts("ERROR: Unable to read from SD Card");
+      return -3;
+    }
+    
+    // NOTE: Bytes per microsecond is MB/s
+    printf(" %-5u kB : %-5u.%02u  %-5u.%02u\n", sizes[x] >> 10,
+      sizes[x] / pio, ((sizes[x] % pio) * 100) / pio,
+      sizes[x] / dma, ((sizes[x] % dma) * 100) / dma);
+  }
+  
+  return 0;
+}
+
+//
+// NOTE: After a warm restart only reload the fabric if it is not in user mode
+//
+
+int sd_card_fpga_user_mode(int step)
+{ return (*FPGAMGR_STAT & 0x00000004) != 0; }
 
-BOOT_STEP(300, sd_card_init, "init sdmmc card");
-BOOT_STEP(301, sd_card_default_rbf, "load uncompressed 'default.rbf' from sdmmc card");
+BOOT_STEP_OPTS(300, sd_card_init, "init sdmmc card", .deps = "clock_init, pinmux_init", 
+  .flags = BOOT_FAIL_SKIP, .retries = 2, .budget_us = 2000000);
+BOOT_STEP_OPTS(301, sd_card_default_rbf, "load uncompressed 'default.rbf' from sdmmc card", 
+  .flags = BOOT_WARM_SKIP, .warm_valid = sd_card_fpga_user_mode, .budget_us = 10000000);
 
 TERMINAL_COMMAND("sd-parts", sd_parts, "Show SD Card Partitons");
 TERMINAL_COMMAND("sd-files", sd_files, "Show SD Card Files appended to PImage in A2 Partition");
 TERMINAL_COMMAND("sd-dump", sd_dump, "{sector bytes | filename}");
-TERMINAL_COMMAND("sd-rbf", sd_rbf, "{filename} {compressed|uncompressed}");
+TERMINAL_COMMAND("sd-rbf", sd_rbf, "{filename} {compressed|uncompressed} [chunk bytes] [cpu|dma]");
+TERMINAL_COMMAND("sd-rbf-bench", sd_rbf_bench, "{filename} {compressed|uncompressed} word vs burst FPGA writes");
+TERMINAL_COMMAND("sd-bench", sd_bench, "[sector] PIO vs DMA read throughput for 4kB, 64kB and 1MB");
 
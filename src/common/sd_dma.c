@@ -0,0 +1,373 @@
+/*
+  SD card reads by the SDMMC internal DMA controller (IDMAC)
+  
+  hwlib's alt_sdmmc_read() waits for the whole transfer, so the command, descriptor
+  chain and completion are handled here at the register level instead.
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include "alt_cache.h"
+#include "boot.h"
+#include "timer.h"
+#include "sd_dma.h"
+
+#define SDMMC_CTRL    ((volatile unsigned int*) 0xFF808000)
+#define SDMMC_BLKSIZ  ((volatile unsigned int*) 0xFF80801C)
+#define SDMMC_BYTCNT  ((volatile unsigned int*) 0xFF808020)
+#define SDMMC_CMDARG  ((volatile unsigned int*) 0xFF808028)
+#define SDMMC_CMD     ((volatile unsigned int*) 0xFF80802C)
+#define SDMMC_RESP0   ((volatile unsigned int*) 0xFF808030)
+#define SDMMC_RINTSTS ((volatile unsigned int*) 0xFF808044)
+#define SDMMC_STATUS  ((volatile unsigned int*) 0xFF808048)
+#define SDMMC_FIFOTH  ((volatile unsigned int*) 0xFF80804C)
+#define SDMMC_BMOD    ((volatile unsigned int*) 0xFF808080)
+#define SDMMC_PLDMND  ((volatile unsigned int*) 0xFF808084)
+#define SDMMC_DBADDR  ((volatile unsigned int*) 0xFF808088)
+#define SDMMC_IDSTS   ((volatile unsigned int*) 0xFF80808C)
+#define SDMMC_IDINTEN ((volatile unsigned int*) 0xFF808090)
+
+#define CTRL_FIFO_RESET 0x00000002
+#define CTRL_DMA_RESET  0x00000004
+#define CTRL_USE_IDMAC  0x02000000
+
+#define BMOD_FB 0x00000002
+#define BMOD_DE 0x00000080
+#define BMOD_PBL 0x00000700
+
+#define FIFOTH_MSIZE    0x70000000
+#define FIFOTH_RX_WMARK 0x0FFF0000
+
+#define CMD_START       0x80000000
+#define CMD_USE_HOLD    0x20000000
+#define CMD_STOP_ABORT  0x00004000
+#define CMD_WAIT_PRV    0x00002000
+#define CMD_AUTO_STOP   0x00001000
+#define CMD_DATA        0x00000200
+#define CMD_CHECK_CRC   0x00000100
+#define CMD_RESP        0x00000040
+
+#define RINT_CD     0x00000004
+#define RINT_DTO    0x00000008
+#define RINT_ACD    0x00004000
+#define RINT_ERRORS 0x0000BFC2 // RE, RCRC, DCRC, RTO, DRTO, HTO, FRUN, HLE, SBE, EBE
+#define RINT_CMD_ERRORS 0x00000142 // RE, RCRC, RTO
+#define RINT_ALL    0xFFFFFFFF
+
+#define IDSTS_RI     0x00000002
+#define IDSTS_ERRORS 0x00000034 // FBE, DU, CES
+#define IDSTS_ALL    0x000003FF
+
+#define STATUS_DATA_BUSY 0x00000200
+
+#define DES0_OWN 0x80000000
+#define DES0_CH  0x00000010
+#define DES0_FS  0x00000008
+#define DES0_LD  0x00000004
+#define DES0_DIC 0x00000002
+
+#define SD_DMA_TIMEOUT_US 1000000 // Per transfer
+
+//
+// Chained descriptors, read by the IDMAC from memory (so cleaned out of the cache)
+//
+
+typedef struct
+{
+  volatile unsigned int des0; // Control/status
+  volatile unsigned int des1; // Buffer size
+  volatile unsigned int des2; // Buffer address
+  volatile unsigned int des3; // Next descriptor
+} sd_dma_desc_t;
+
+sd_dma_desc_t sd_dma_desc[SD_DMA_DESCS] __attribute__((aligned(SD_DMA_ALIGN)));
+
+struct
+{
+  int block_addr;          // Card takes sector numbers, not byte offsets
+  int busy;
+  void *dest;
+  unsigned int size;       // Cache lines covered by 'dest'
+  unsigned int done;       // RINTSTS bits that end the transfer
+  unsigned int fifoth;     // FIFOTH to put back after a short block, 0 if not changed
+  unsigned long long start;
+} sd_dma;
+
+//
+// Controller control
+//
+
+// Wait up to 10ms for the 'mask' bits of 'reg' to read as 'value'
+static int sd_dma_wait(volatile unsigned int *reg, unsigned int mask, unsigned int value)
+{
+  unsigned long long start;
+  
+  start = timer_ticks();
+  
+  while ((*reg & mask) != value)
+    if (timer_ticks_to_us(timer_ticks() - start) > 10000)
+      return -1;
+  
+  return 0;
+}
+
+static void sd_dma_stop()
+{
+  *SDMMC_BMOD &= ~BMOD_DE;
+  *SDMMC_CTRL &= ~CTRL_USE_IDMAC;
+  *SDMMC_CTRL |= (CTRL_FIFO_RESET | CTRL_DMA_RESET);
+  sd_dma_wait(SDMMC_CTRL, CTRL_FIFO_RESET | CTRL_DMA_RESET, 0);
+  
+  *SDMMC_RINTSTS = RINT_ALL;
+  *SDMMC_IDSTS = IDSTS_ALL;
+  
+  if (sd_dma.fifoth != 0)
+  {
+    *SDMMC_FIFOTH = sd_dma.fifoth;
+    *SDMMC_BMOD = (*SDMMC_BMOD & ~BMOD_PBL) | (((sd_dma.fifoth >> 28) & 0x7) << 8);
+    sd_dma.fifoth = 0;
+  }
+  
+  sd_dma.busy = 0;
+}
+
+int sd_dma_init(int block_addr)
+{
+  sd_dma.block_addr = block_addr;
+  sd_dma.busy = 0;
+  sd_dma.fifoth = 0;
+  
+  // Software reset, then bursts the same size as the FIFO threshold (PBL uses the MSIZE encoding)
+  *SDMMC_BMOD = 0x00000001;
+  
+  if (sd_dma_wait(SDMMC_BMOD, 0x00000001, 0))
+    return -1;
+  
+  *SDMMC_BMOD = BMOD_FB | (((*SDMMC_FIFOTH >> 28) & 0x7) << 8);
+  *SDMMC_IDINTEN = 0; // NOTE: Polled, see sd_dma_read_poll()
+  
+  sd_dma_stop();
+  return 0;
+}
+
+//
+// Commands
+//
+
+int sd_dma_cmd(unsigned int cmd, unsigned int arg, unsigned int *resp)
+{
+  if (sd_dma.busy)
+    return -1;
+  
+  *SDMMC_RINTSTS = RINT_ALL;
+  *SDMMC_CMDARG = arg;
+  *SDMMC_CMD = CMD_START | CMD_USE_HOLD | CMD_WAIT_PRV | CMD_CHECK_CRC | CMD_RESP | (cmd & 0x3F);
+  
+  if (sd_dma_wait(SDMMC_CMD, CMD_START, 0) || sd_dma_wait(SDMMC_RINTSTS, RINT_CD, RINT_CD))
+    return -4;
+  
+  if (*SDMMC_RINTSTS & RINT_CMD_ERRORS)
+    return -2;
+  
+  if (resp)
+    *resp = *SDMMC_RESP0;
+  
+  return 0;
+}
+
+//
+// Transfers
+// - 'cmd' is the whole CMD register value, less the start bit
+//
+
+static int sd_dma_start(unsigned int cmd, unsigned int arg, void *dest, unsigned int size,
+  unsigned int blksz, unsigned int bytes)
+{
+  unsigned int offset;
+  unsigned int len;
+  int x;
+  
+  if (sd_dma.busy || (bytes == 0) || (bytes % blksz) || (size == 0) || (size % blksz) ||
+    ((unsigned int) dest & (SD_DMA_ALIGN - 1)))
+  {
+    return -1;
+  }
+  
+  // One descriptor per 4kB, starting over at 'dest' every 'size' bytes
+  offset = 0;
+  x = 0;
+  
+  while (bytes > 0)
+  {
+    if (x == SD_DMA_DESCS)
+      return -1;
+    
+    len = size - (offset % size);
+    
+    if (len > SD_DMA_DESC_BYTES)
+      len = SD_DMA_DESC_BYTES;
+    
+    if (len > bytes)
+      len = bytes;
+    
+    sd_dma_desc[x].des0 = DES0_OWN | DES0_CH | DES0_DIC;
+    sd_dma_desc[x].des1 = len;
+    sd_dma_desc[x].des2 = (unsigned int) dest + (offset % size);
+    sd_dma_desc[x].des3 = (unsigned int) &sd_dma_desc[x + 1];
+    
+    offset += len;
+    bytes -= len;
+    x++;
+  }
+  
+  sd_dma_desc[0].des0 |= DES0_FS;
+  sd_dma_desc[x - 1].des0 = (sd_dma_desc[x - 1].des0 & ~DES0_DIC) | DES0_LD;
+  sd_dma_desc[x - 1].des3 = 0;
+  
+  if (size > offset)
+    size = offset;
+  
+  sd_dma.dest = dest;
+  sd_dma.size = (size + SD_DMA_ALIGN - 1) & ~(SD_DMA_ALIGN - 1);
+  sd_dma.done = RINT_DTO | ((cmd & CMD_AUTO_STOP) ? RINT_ACD : 0);
+  sd_dma.busy = 1;
+  
+  // Descriptors out to memory, no dirty lines left to be evicted over the incoming data
+  alt_cache_system_clean(sd_dma_desc, sizeof(sd_dma_desc));
+  alt_cache_system_purge(sd_dma.dest, sd_dma.size);
+  
+  *SDMMC_CTRL |= (CTRL_FIFO_RESET | CTRL_DMA_RESET);
+  
+  if (sd_dma_wait(SDMMC_CTRL, CTRL_FIFO_RESET | CTRL_DMA_RESET, 0))
+  {
+    sd_dma_stop();
+    return -2;
+  }
+  
+  // NOTE: A block smaller than one burst (i.e. the 8 byte SCR) never reaches the RX
+  //       watermark, so like Linux dw_mmc use single word bursts until sd_dma_stop()
+  if (blksz < (SD_DMA_BURST_WORDS * 4))
+  {
+    sd_dma.fifoth = *SDMMC_FIFOTH;
+    *SDMMC_FIFOTH = sd_dma.fifoth & ~(FIFOTH_MSIZE | FIFOTH_RX_WMARK);
+    *SDMMC_BMOD &= ~BMOD_PBL;
+  }
+  
+  *SDMMC_RINTSTS = RINT_ALL;
+  *SDMMC_IDSTS = IDSTS_ALL;
+  *SDMMC_BLKSIZ = blksz;
+  *SDMMC_BYTCNT = offset;
+  *SDMMC_DBADDR = (unsigned int) &sd_dma_desc[0];
+  *SDMMC_CTRL |= CTRL_USE_IDMAC;
+  *SDMMC_BMOD |= BMOD_DE;
+  *SDMMC_PLDMND = 1;
+  
+  *SDMMC_CMDARG = arg;
+  *SDMMC_CMD = CMD_START | cmd;
+  
+  if (sd_dma_wait(SDMMC_CMD, CMD_START, 0))
+  {
+    sd_dma_stop();
+    return -2;
+  }
+  
+  sd_dma.start = timer_ticks();
+  return 0;
+}
+
+int sd_dma_read_start(void *dest, unsigned int size, unsigned int sector, unsigned int bytes)
+{
+  // READ_MULTIPLE_BLOCK, the controller sends STOP_TRANSMISSION when the byte count is done
+  return sd_dma_start(CMD_USE_HOLD | CMD_WAIT_PRV | CMD_AUTO_STOP | CMD_DATA | CMD_CHECK_CRC | CMD_RESP | 18,
+    sd_dma.block_addr ? sector : (sector * 512), dest, size, 512, bytes);
+}
+
+// Put the card back in the transfer state after a failed READ_MULTIPLE_BLOCK
+static void sd_dma_stop_card()
+{
+  if (sd_dma.done & RINT_ACD)
+  {
+    *SDMMC_CMDARG = 0;
+    *SDMMC_CMD = CMD_START | CMD_USE_HOLD | CMD_STOP_ABORT | CMD_CHECK_CRC | CMD_RESP | 12;
+    sd_dma_wait(SDMMC_CMD, CMD_START, 0);
+  }
+}
+
+int sd_dma_read_poll()
+{
+  unsigned int rint;
+  
+  if (!sd_dma.busy)
+    return -1;
+  
+  rint = *SDMMC_RINTSTS;
+  
+  if ((rint & RINT_ERRORS) || (*SDMMC_IDSTS & IDSTS_ERRORS))
+  {
+    sd_dma_stop_card();
+    sd_dma_stop();
+    return -2;
+  }
+  
+  if (((rint & sd_dma.done) != sd_dma.done) || !(*SDMMC_IDSTS & IDSTS_RI) ||
+    (*SDMMC_STATUS & STATUS_DATA_BUSY))
+  {
+    if (timer_ticks_to_us(timer_ticks() - sd_dma.start) > SD_DMA_TIMEOUT_US)
+    {
+      sd_dma_stop_card();
+      sd_dma_stop();
+      return -4;
+    }
+    
+    return BOOT_BUSY;
+  }
+  
+  // NOTE: Lines may have been fetched (speculatively) while the data came in
+  alt_cache_system_invalidate(sd_dma.dest, sd_dma.size);
+  
+  sd_dma_stop();
+  return 0;
+}
+
+static int sd_dma_finish(int rtn)
+{
+  if (rtn != 0)
+    return rtn;
+  
+  do
+  {
+    rtn = sd_dma_read_poll();
+  } while (rtn == BOOT_BUSY);
+  
+  return rtn;
+}
+
+int sd_dma_read(void *dest, unsigned int sector, unsigned int bytes)
+{ return sd_dma_finish(sd_dma_read_start(dest, bytes, sector, bytes)); }
+
+int sd_dma_read_block(unsigned int cmd, unsigned int arg, void *dest, unsigned int bytes)
+{
+  return sd_dma_finish(sd_dma_start(CMD_USE_HOLD | CMD_WAIT_PRV | CMD_DATA | CMD_CHECK_CRC | CMD_RESP | (cmd & 0x3F),
+    arg, dest, bytes, bytes, bytes));
+}
@@ -0,0 +1,294 @@
+/*
+  printf style formatting core for simple_stdio
+  
+  Kept free of hardware dependencies so it also builds on the host
+  (see src/tools/printf_bench.c)
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include "simple_format.h"
+#include <stdint.h>
+#include <string.h>
+
+static inline void sink_putc(stdio_sink_t *sink, char c)
+{
+  sink->total++;
+  
+  if (sink->pos >= sink->size)
+  {
+    if (sink->drain == (void*)0)
+      return;
+    
+    sink->drain(sink);
+  }
+  
+  sink->buf[sink->pos++] = c;
+}
+
+//
+// Integer to ASCII, digits are written backwards ending just before 'end' and the
+// first digit is returned
+// - The Cortex A9 has no divide instruction, so decimal conversion divides by 100
+//   with a multiply by reciprocal (exact for all 32-bit values) and emits two
+//   digits per step from a table
+//
+
+static const char format_digit_pairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+static char *format_u32(char *end, uint32_t v)
+{
+  uint32_t q;
+  uint32_t r;
+  
+  while (v >= 100)
+  {
+    q = (uint32_t) (((uint64_t) v * 0x51EB851FU) >> 37); // v / 100
+    r = (v - (q * 100)) * 2;
+    
+    *(--end) = format_digit_pairs[r + 1];
+    *(--end) = format_digit_pairs[r];
+    v = q;
+  }
+  
+  if (v >= 10)
+  {
+    *(--end) = format_digit_pairs[(v * 2) + 1];
+    *(--end) = format_digit_pairs[v * 2];
+  }
+  else
+  {
+    *(--end) = (char) v + '0';
+  }
+  
+  return end;
+}
+
+static char *format_u64(char *end, uint64_t v)
+{
+  uint64_t q;
+  char *ptr;
+  
+  // NOTE: Only values past 32-bits pay for a (libgcc) 64-bit divide, at most two
+  while (v > 0xFFFFFFFFULL)
+  {
+    q = v / 1000000000;
+    ptr = format_u32(end, (uint32_t) (v - (q * 1000000000)));
+    
+    while (ptr > (end - 9))
+      *(--ptr) = '0';
+    
+    end = ptr;
+    v = q;
+  }
+  
+  return format_u32(end, (uint32_t) v);
+}
+
+static char *format_hex(char *end, uint64_t v, int upper)
+{
+  const char *digits;
+  
+  digits = (upper) ? "0123456789ABCDEF" : "0123456789abcdef";
+  
+  do
+  {
+    *(--end) = digits[v & 0xF];
+    v = v >> 4;
+  } while (v != 0);
+  
+  return end;
+}
+
+int stdio_format(stdio_sink_t *sink, char *f, va_list args)
+{
+  char *f_ptr;
+  int right_justify;
+  int zero_pad;
+  int field_width;
+  int long_arg;
+  char num_buf[32];
+  char *str;
+  int len;
+  long long snum;
+  unsigned long long unum;
+  
+  f_ptr = f;
+  
+  while (*f_ptr != '\0')
+  {
+    if (*f_ptr == '%')
+    {
+      f_ptr++;
+      right_justify = 0;
+      zero_pad = 0;
+      field_width = 0;
+      long_arg = 0;
+      
+      if (*f_ptr == '%')
+      {
+        sink_putc(sink, *f_ptr);
+        f_ptr++;
+        continue;
+      }
+      
+      if (*f_ptr == '-')
+      {
+        right_justify = 1;
+        f_ptr++;
+      }
+      
+      while (*f_ptr == '0')
+      {
+        zero_pad = 1;
+        f_ptr++;
+      }
+      
+      while ((*f_ptr >= '0') && (*f_ptr <= '9'))
+      {
+        field_width *= 10;
+        field_width += *f_ptr - '0';
+        f_ptr++;
+      }
+
+      while ((*f_ptr == 'l') || (*f_ptr == 'L'))
+      {
+        long_arg++;
+        f_ptr++;
+      }
+      
+      // NOTE: Plain 'l' is the same as int on the target, but not on a 64-bit host
+      if ((long_arg == 1) && (sizeof(long) > sizeof(int)))
+        long_arg = 2;
+      
+      num_buf[sizeof(num_buf) - 1] = '\0';
+      str = &num_buf[sizeof(num_buf) - 1];
+      
+      if ((*f_ptr == 'd') || (*f_ptr == 'i'))
+      {
+        if (long_arg > 1)
+          snum = va_arg(args, long long);
+        else
+          snum = va_arg(args, int);
+        
+        if (snum < 0)
+          unum = 0 - (unsigned long long) snum;
+        else
+          unum = snum;
+        
+        if (long_arg > 1)
+          str = format_u64(str, unum);
+        else
+          str = format_u32(str, (uint32_t) unum);
+        
+        if (snum < 0)
+          *(--str) = '-';
+        
+        f_ptr++;
+      }
+      else if (*f_ptr == 'u')
+      {
+        if (long_arg > 1)
+          str = format_u64(str, va_arg(args, unsigned long long));
+        else
+          str = format_u32(str, va_arg(args, unsigned int));
+        
+        f_ptr++;
+      }
+      else if ((*f_ptr == 'x') || (*f_ptr == 'X') || (*f_ptr == 'p'))
+      {
+        if (*f_ptr == 'p')
+        {
+          field_width = 8;
+          zero_pad = 1;
+          unum = (unsigned int) (uintptr_t) va_arg(args, void *);
+        }
+        else if (long_arg > 1)
+          unum = va_arg(args, unsigned long long);
+        else
+          unum = va_arg(args, unsigned int);
+        
+        str = format_hex(str, unum, (*f_ptr != 'x'));
+        f_ptr++;
+      }
+      else if (*f_ptr == 's')
+      {
+        str = va_arg(args, char *);
+        f_ptr++;
+      }
+      else
+      {
+        str = "%BAD%";
+        f_ptr++;
+      }
+      
+      len = strlen(str);
+      if (right_justify || zero_pad)
+      {
+        while (len < field_width)
+        {
+          sink_putc(sink, (zero_pad) ? '0' : ' ');
+          len++;
+        }
+      }
+      while (*str != '\0')
+      {
+        sink_putc(sink, *str);
+        str++;
+      }
+      while (len < field_width)
+      {
+        sink_putc(sink, ' ');
+        len++;
+      }
+    }
+    else if (*f_ptr != '\0')
+    {
+      if (*f_ptr == '\n')
+        sink_putc(sink, '\r');
+      
+      sink_putc(sink, *f_ptr);
+      
+      if (*f_ptr == '\r')
+        sink_putc(sink, '\n');
+      
+      f_ptr++;
+    }
+  }
+  
+  if ((sink->drain != (void*)0) && (sink->pos > 0))
+    sink->drain(sink);
+  
+  return sink->total;
+}
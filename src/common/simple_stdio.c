@@ -29,12 +29,17 @@ SOFTWARE.
 */
 
 #include "simple_stdio.h"
+#include "simple_format.h"
 #include <string.h>
 #include <stdarg.h>
 #include "alt_16550_uart.h"
+#include "alt_interrupt.h"
+#include "timer.h"
+#include "boot.h"
+#include "terminal.h"
 
 // NOTE: This handle must be initialized before using stdio gets/puts/printf/etc.
-//       If not initialized, stdio will be silently dropped/skipped
+//       If not initialized, input is skipped and output is only logged (see 'dmesg')
 ALT_16550_HANDLE_t _stdio_uart_handle =
 {
   .device = -1,
@@ -44,6 +49,452 @@ ALT_16550_HANDLE_t _stdio_uart_handle =
   .fcr = 0,
 };
 
+//
+// Interrupt driven output
+// - Bytes are queued in a ring and moved to the UART FIFO by the TX empty interrupt
+// - Output is polled until stdio_irq_init() runs (boot step 160) and after shutdown
+// - With IRQs masked (i.e. from an ISR) a full ring is drained by polling instead
+//
+
+#define STDIO_TX_RING_SIZE 4096 // NOTE: Must be a power of 2
+#define STDIO_TX_RING_MASK (STDIO_TX_RING_SIZE - 1)
+
+char stdio_tx_ring[STDIO_TX_RING_SIZE];
+volatile unsigned int stdio_tx_head; // Only written by stdio_tx()
+volatile unsigned int stdio_tx_tail; // Only written by stdio_tx_fill()
+volatile int stdio_irq_enabled;
+
+uint32_t stdio_tx_fsize; // NOTE: TX FIFO depth, read once on first use
+
+static inline uint32_t stdio_tx_fifo_size()
+{
+  if (stdio_tx_fsize == 0)
+    alt_16550_fifo_size_get_tx(&_stdio_uart_handle, &stdio_tx_fsize);
+  
+  return stdio_tx_fsize;
+}
+
+#ifdef HOST_BUILD // NOTE: 'make host-test', interrupts are never enabled there
+
+static inline uint32_t stdio_irq_save() { return 0; }
+static inline void stdio_irq_restore(uint32_t cpsr) { return; }
+static inline int stdio_irq_masked() { return 0; }
+
+#else
+
+static inline uint32_t stdio_irq_save()
+{
+  uint32_t cpsr;
+  __asm volatile("mrs %0, cpsr;\ncpsid i;\n" : "=r" (cpsr) : : "memory");
+  return cpsr;
+}
+
+static inline void stdio_irq_restore(uint32_t cpsr)
+{ __asm volatile("msr cpsr_c, %0;\n" : : "r" (cpsr) : "memory"); }
+
+static inline int stdio_irq_masked()
+{
+  uint32_t cpsr;
+  __asm volatile("mrs %0, cpsr;\n" : "=r" (cpsr));
+  return (cpsr & 0x80) != 0;
+}
+
+#endif
+
+ALT_INT_INTERRUPT_t stdio_irq_id()
+{
+  if (_stdio_uart_handle.device == ALT_16550_DEVICE_SOCFPGA_UART0)
+    return ALT_INT_INTERRUPT_UART0;
+  
+  return ALT_INT_INTERRUPT_UART1;
+}
+
+// Move as much of the ring as fits into the TX FIFO
+void stdio_tx_fill()
+{
+  uint32_t level;
+  uint32_t fsize;
+  unsigned int tail;
+  unsigned int n;
+  
+  fsize = stdio_tx_fifo_size();
+  alt_16550_fifo_level_get_tx(&_stdio_uart_handle, &level);
+  
+  tail = stdio_tx_tail;
+  
+  while ((level < fsize) && (tail != stdio_tx_head))
+  {
+    n = stdio_tx_head - tail;
+    
+    if (n > (STDIO_TX_RING_SIZE - (tail & STDIO_TX_RING_MASK)))
+      n = STDIO_TX_RING_SIZE - (tail & STDIO_TX_RING_MASK);
+    
+    if (n > (fsize - level))
+      n = fsize - level;
+    
+    alt_16550_fifo_write(&_stdio_uart_handle, &stdio_tx_ring[tail & STDIO_TX_RING_MASK], n);
+    
+    tail += n;
+    level += n;
+  }
+  
+  stdio_tx_tail = tail;
+}
+
+//
+// Interrupt driven input
+// - The RX interrupt moves bytes from the FIFO into a ring, so input that arrives while
+//   a command is busy (or echoing) is not lost to a FIFO overrun
+// - Input is read from the FIFO directly until stdio_irq_init() runs and after shutdown
+//
+
+#define STDIO_RX_RING_SIZE 1024 // NOTE: Must be a power of 2
+#define STDIO_RX_RING_MASK (STDIO_RX_RING_SIZE - 1)
+
+char stdio_rx_ring[STDIO_RX_RING_SIZE];
+volatile unsigned int stdio_rx_head;    // Only written by stdio_rx_drain()
+volatile unsigned int stdio_rx_tail;    // Only written by getchar_nb() and ctrlc()
+volatile unsigned int stdio_rx_dropped; // Bytes lost because the ring was full
+
+// Move everything in the RX FIFO into the ring
+void stdio_rx_drain()
+{
+  uint32_t level;
+  unsigned int head;
+  char c;
+  
+  alt_16550_fifo_level_get_rx(&_stdio_uart_handle, &level);
+  
+  head = stdio_rx_head;
+  
+  while (level-- > 0)
+  {
+    alt_16550_fifo_read(&_stdio_uart_handle, &c, 1);
+    
+    if ((head - stdio_rx_tail) < STDIO_RX_RING_SIZE)
+      stdio_rx_ring[(head++) & STDIO_RX_RING_MASK] = c;
+    else
+      stdio_rx_dropped++;
+  }
+  
+  stdio_rx_head = head;
+}
+
+void stdio_uart_isr(uint32_t icciar, void *context)
+{
+  ALT_16550_INT_STATUS_t status;
+  
+  alt_16550_int_status_get(&_stdio_uart_handle, &status); // NOTE: Clears TX empty
+  
+  stdio_rx_drain();
+  stdio_tx_fill();
+  
+  if (stdio_tx_tail == stdio_tx_head)
+    alt_16550_int_disable_tx(&_stdio_uart_handle);
+}
+
+// All UART output goes through here (no newline translation)
+void stdio_tx(const char *buf, int len)
+{
+  uint32_t level;
+  uint32_t fsize;
+  uint32_t cpsr;
+  unsigned int head;
+  unsigned int n;
+  
+  if (!stdio_irq_enabled)
+  {
+    fsize = stdio_tx_fifo_size();
+    
+    // NOTE: One level read per FIFO refill, then one write for all that fits
+    while (len > 0)
+    {
+      alt_16550_fifo_level_get_tx(&_stdio_uart_handle, &level);
+      
+      if (level >= fsize)
+        continue;
+      
+      n = fsize - level;
+      
+      if (n > (unsigned int) len)
+        n = len;
+      
+      alt_16550_fifo_write(&_stdio_uart_handle, buf, n);
+      
+      buf += n;
+      len -= n;
+    }
+    
+    return;
+  }
+  
+  while (len > 0)
+  {
+    head = stdio_tx_head;
+    n = STDIO_TX_RING_SIZE - (head - stdio_tx_tail);
+    
+    if (n == 0)
+    {
+      if (stdio_irq_masked())
+        stdio_tx_fill();
+      
+      continue;
+    }
+    
+    if (n > (STDIO_TX_RING_SIZE - (head & STDIO_TX_RING_MASK)))
+      n = STDIO_TX_RING_SIZE - (head & STDIO_TX_RING_MASK);
+    
+    if (n > (unsigned int) len)
+      n = len;
+    
+    memcpy(&stdio_tx_ring[head & STDIO_TX_RING_MASK], buf, n);
+    __asm volatile("" : : : "memory"); // NOTE: Data must be in the ring before the ISR sees it
+    stdio_tx_head = head + n;
+    
+    buf += n;
+    len -= n;
+    
+    // NOTE: Kick the ISR, it turns itself off again once the ring is empty
+    cpsr = stdio_irq_save();
+    alt_16550_int_enable_tx(&_stdio_uart_handle);
+    stdio_irq_restore(cpsr);
+  }
+}
+
+//
+// Output log ('dmesg')
+// - Everything written by stdio (except write_raw()) is copied into a ring, including
+//   what is written before stdio_init() sets up the UART
+// - That early output is sent with the first write once the UART is available
+//
+
+#define STDIO_LOG_SIZE 8192 // NOTE: Must be a power of 2
+#define STDIO_LOG_MASK (STDIO_LOG_SIZE - 1)
+
+char stdio_log[STDIO_LOG_SIZE];
+unsigned int stdio_log_head;  // Bytes ever logged
+unsigned int stdio_log_early; // Logged, but not sent (no UART at the time)
+unsigned int stdio_log_start; // Where 'dmesg' starts ('dmesg clear')
+
+void stdio_log_write(const char *buf, int len)
+{
+  unsigned int n;
+  
+  if (len > STDIO_LOG_SIZE)
+  {
+    stdio_log_head += len - STDIO_LOG_SIZE;
+    buf += len - STDIO_LOG_SIZE;
+    len = STDIO_LOG_SIZE;
+  }
+  
+  n = STDIO_LOG_SIZE - (stdio_log_head & STDIO_LOG_MASK);
+  
+  if (n > (unsigned int) len)
+    n = len;
+  
+  memcpy(&stdio_log[stdio_log_head & STDIO_LOG_MASK], buf, n);
+  memcpy(stdio_log, buf + n, len - n);
+  
+  stdio_log_head += len;
+}
+
+// Send the log from byte 'from' on (or as much of that as is still in the ring)
+void stdio_log_send(unsigned int from)
+{
+  unsigned int n;
+  
+  if ((stdio_log_head - from) > STDIO_LOG_SIZE)
+    from = stdio_log_head - STDIO_LOG_SIZE;
+  
+  while (from != stdio_log_head)
+  {
+    n = STDIO_LOG_SIZE - (from & STDIO_LOG_MASK);
+    
+    if (n > (stdio_log_head - from))
+      n = stdio_log_head - from;
+    
+    stdio_tx(&stdio_log[from & STDIO_LOG_MASK], n);
+    from += n;
+  }
+}
+
+void stdio_write(const char *buf, int len)
+{
+  stdio_log_write(buf, len);
+  
+  if (_stdio_uart_handle.device < 0)
+  {
+    stdio_log_early += len;
+    return;
+  }
+  
+  if (stdio_log_early != 0)
+  {
+    stdio_log_send(stdio_log_head - stdio_log_early - len); // NOTE: Includes this write
+    stdio_log_early = 0;
+    return;
+  }
+  
+  stdio_tx(buf, len);
+}
+
+// Text output, '\n' and '\r' both become "\r\n"
+// - Expanded into a staging buffer so the FIFO/ring sees a few large writes
+//   instead of up to three single byte writes per character
+
+#define STDIO_STAGE_SIZE 128
+
+void stdio_write_text(const char *s, int len)
+{
+  char stage[STDIO_STAGE_SIZE];
+  int n;
+  
+  n = 0;
+  
+  while (len-- > 0)
+  {
+    if (n > (STDIO_STAGE_SIZE - 2))
+    {
+      stdio_write(stage, n);
+      n = 0;
+    }
+    
+    if ((*s == '\n') || (*s == '\r'))
+    {
+      stage[n++] = '\r';
+      stage[n++] = '\n';
+    }
+    else
+    {
+      stage[n++] = *s;
+    }
+    
+    s++;
+  }
+  
+  if (n > 0)
+    stdio_write(stage, n);
+}
+
+int stdio_irq_init(int step)
+{
+  ALT_STATUS_CODE status;
+  
+  if (_stdio_uart_handle.device < 0)
+    return 0;
+  
+  stdio_tx_head = 0;
+  stdio_tx_tail = 0;
+  stdio_rx_head = 0;
+  stdio_rx_tail = 0;
+  
+  status = alt_int_isr_register(stdio_irq_id(), stdio_uart_isr, (void*)0);
+  
+  if (status == ALT_E_SUCCESS)
+    status = alt_int_dist_target_set(stdio_irq_id(), 0x1);
+  
+  if (status == ALT_E_SUCCESS)
+    status = alt_int_dist_enable(stdio_irq_id());
+  
+  if (status == ALT_E_SUCCESS)
+  {
+    stdio_irq_enabled = 1;
+    status = alt_16550_int_enable_rx(&_stdio_uart_handle);
+  }
+  
+  return status;
+}
+
+// Re-enable the UART interrupts after stdio_init() re-ran alt_16550_init() (which clears them)
+int stdio_irq_rearm()
+{
+  if (!stdio_irq_enabled)
+    return 0;
+  
+  alt_16550_int_enable_tx(&_stdio_uart_handle); // NOTE: Turns itself off once the ring is empty
+  
+  return alt_16550_int_enable_rx(&_stdio_uart_handle);
+}
+
+int stdio_irq_uninit(int step)
+{
+  if (!stdio_irq_enabled)
+    return 0;
+  
+  flush();
+  
+  stdio_irq_enabled = 0; // NOTE: Anything left in the RX ring is dropped
+  alt_16550_int_disable_rx(&_stdio_uart_handle);
+  alt_16550_int_disable_tx(&_stdio_uart_handle);
+  alt_int_dist_disable(stdio_irq_id());
+  
+  return alt_int_isr_unregister(stdio_irq_id());
+}
+
+//
+// Baud rate
+// - Boards program stdio_baudrate in stdio_init(), so it also survives a clock change
+//   ('clock-setting commit') and a restart (the host side does not change either)
+//
+
+unsigned int stdio_baudrate = ALT_16550_BAUDRATE_115200;
+
+// Highest rate the UART clock allows (divisor of 1)
+unsigned int stdio_baudrate_max()
+{
+  return _stdio_uart_handle.clock_freq / 16;
+}
+
+// Rate the divisor for 'baud' really gives, 0 if more than 2.5% off
+unsigned int stdio_baudrate_actual(unsigned int baud)
+{
+  unsigned int divisor;
+  unsigned int actual;
+  
+  if ((baud == 0) || (baud > stdio_baudrate_max()))
+    return 0;
+  
+  divisor = (_stdio_uart_handle.clock_freq + (8 * baud)) / (16 * baud);
+  
+  if ((divisor == 0) || (divisor > 0xFFFF))
+    return 0;
+  
+  actual = _stdio_uart_handle.clock_freq / (16 * divisor);
+  
+  if ((((actual > baud) ? (actual - baud) : (baud - actual)) * 40) > baud)
+    return 0;
+  
+  return actual;
+}
+
+int stdio_baudrate_set(unsigned int baud)
+{
+  ALT_STATUS_CODE status;
+  
+  if (_stdio_uart_handle.device < 0)
+    return -1;
+  
+  if (stdio_baudrate_actual(baud) == 0)
+    return -2;
+  
+  flush();
+  
+  // NOTE: hwlib only changes the divisor while the UART is disabled, which also
+  //       clears the interrupt enables
+  status = alt_16550_disable(&_stdio_uart_handle);
+  
+  if (status == ALT_E_SUCCESS)
+    status = alt_16550_baudrate_set(&_stdio_uart_handle, baud);
+  
+  if (status == ALT_E_SUCCESS)
+    stdio_baudrate = baud;
+  
+  alt_16550_enable(&_stdio_uart_handle);
+  stdio_irq_rearm();
+  
+  return status;
+}
+
 void chomp(char *s)
 {
   char *ptr;
@@ -72,6 +523,12 @@ void flush()
 
   if (_stdio_uart_handle.device < 0)
     return;
+  
+  while (stdio_irq_enabled && (stdio_tx_tail != stdio_tx_head))
+  {
+    if (stdio_irq_masked())
+      stdio_tx_fill();
+  }
     
   do
   {
@@ -86,30 +543,84 @@ void flush()
   return;
 }
 
+int kbhit(void)
+{
+  uint32_t level;
+
+  if (_stdio_uart_handle.device < 0)
+    return 0;
+  
+  if (stdio_irq_enabled)
+    return stdio_rx_head != stdio_rx_tail;
+  
+  alt_16550_fifo_level_get_rx(&_stdio_uart_handle, &level);
+  return level > 0;
+}
+
+int getchar_nb(void)
+{
+  unsigned int tail;
+  unsigned char buf;
+
+  if (!kbhit())
+    return -1;
+  
+  if (!stdio_irq_enabled)
+  {
+    alt_16550_fifo_read(&_stdio_uart_handle, (char*) &buf, 1);
+    return (int) buf;
+  }
+  
+  tail = stdio_rx_tail;
+  buf = (unsigned char) stdio_rx_ring[tail & STDIO_RX_RING_MASK];
+  __asm volatile("" : : : "memory"); // NOTE: Read the byte before the ISR can reuse the slot
+  stdio_rx_tail = tail + 1;
+  
+  return (int) buf;
+}
+
+int ctrlc(void)
+{
+  unsigned int tail;
+  int c;
+  
+  if (!stdio_irq_enabled)
+  {
+    // NOTE: No way to put a byte back into the FIFO, anything else typed is dropped
+    while ((c = getchar_nb()) >= 0)
+      if (c == 0x03)
+        return 1;
+    
+    return 0;
+  }
+  
+  for (tail = stdio_rx_tail; tail != stdio_rx_head; tail++)
+  {
+    if (stdio_rx_ring[tail & STDIO_RX_RING_MASK] == 0x03)
+    {
+      stdio_rx_tail = tail + 1; // NOTE: Also drops what was typed before the Ctrl-C
+      return 1;
+    }
+  }
+  
+  return 0;
+}
+
 int getchar(void)
 {
   int rtn;
-  uint32_t level;
-  char buf;
 
   if (_stdio_uart_handle.device < 0)
     return 0;
-      
-  level = 0;
-  do {
-    alt_16550_fifo_level_get_rx(&_stdio_uart_handle, &level);
-  } while (level <= 0);
   
-  alt_16550_fifo_read(&_stdio_uart_handle, &buf, 1);
+  while ((rtn = getchar_nb()) < 0);
   
-  rtn = (int) buf;
   return rtn;
 }
 
 char *safe_gets(char *s, int max)
 {
   char *ptr;
-  uint32_t level;
 
   if (_stdio_uart_handle.device < 0)
   {
@@ -120,7 +631,6 @@ char *safe_gets(char *s, int max)
   }
       
   ptr = s;
-  level = 0;
   
   if (max == 0)
     return s;
@@ -129,22 +639,11 @@ char *safe_gets(char *s, int max)
   
   while (max > 0)
   {
-    while (level <= 0)
-    { alt_16550_fifo_level_get_rx(&_stdio_uart_handle, &level); }
-  
-    alt_16550_fifo_read(&_stdio_uart_handle, ptr, 1);
-    level--;
+    *ptr = (char) getchar();
     
     if ((*ptr == '\r') || (*ptr == '\n'))
     {
-      if (*ptr == '\n')
-        alt_16550_fifo_write(&_stdio_uart_handle, "\r", 1);
-    
-      alt_16550_fifo_write(&_stdio_uart_handle, ptr, 1);
-      
-      if (*ptr == '\r')
-        alt_16550_fifo_write(&_stdio_uart_handle, "\n", 1);
-        
+      stdio_write_text(ptr, 1);
       ptr++;
       break;
     }
@@ -152,14 +651,14 @@ char *safe_gets(char *s, int max)
     {
       if (ptr != s)
       {
-        alt_16550_fifo_write(&_stdio_uart_handle, "\b \b", 3);
+        stdio_write("\b \b", 3);
         ptr--;
         max++;
       }
     }
     else
     {
-      alt_16550_fifo_write(&_stdio_uart_handle, ptr, 1);
+      stdio_write(ptr, 1);
       ptr++;
       max--;
     }
@@ -176,435 +675,240 @@ char *gets(char *s)
 
 int putchar(int c)
 {
-  uint32_t level;
-  uint32_t fsize;
   char buf;
-
-  if (_stdio_uart_handle.device < 0)
-    return 0;
-      
-  alt_16550_fifo_size_get_tx(&_stdio_uart_handle, &fsize);
-  fsize -= 2; // need 2 bytes in fifo
-  
-  do {
-    alt_16550_fifo_level_get_tx(&_stdio_uart_handle, &level);
-  } while (level >= fsize);
   
   buf = (char) (c & 0xFF);
-  
-  if (buf == '\n')
-    alt_16550_fifo_write(&_stdio_uart_handle, "\r", 1);
-    
-  alt_16550_fifo_write(&_stdio_uart_handle, &buf, 1);
-      
-  if (buf == '\r')
-    alt_16550_fifo_write(&_stdio_uart_handle, "\n", 1);
+  stdio_write_text(&buf, 1);
     
   return c;
 }
 
-int puts(char *s)
+int getchar_timeout(unsigned int usec)
 {
-  char *ptr;
-  uint32_t level;
-  uint32_t fsize;
+  unsigned long long timeout;
   int rtn;
 
   if (_stdio_uart_handle.device < 0)
-    return 0;
-      
-  alt_16550_fifo_size_get_tx(&_stdio_uart_handle, &fsize);
-  fsize -= 2; // need 2 bytes in fifo
-  ptr = s;
-  level = fsize;
-  rtn = 0;
+    return -1;
   
-  while (1)
-  {
-    while (level >= fsize)
-    { alt_16550_fifo_level_get_tx(&_stdio_uart_handle, &level); }
+  timeout = timer_ticks() + ((unsigned long long) timer_ticks_per_us() * usec);
   
-    if (*ptr == '\0')
-      break;
-      
-    if (*ptr == '\n')
-      alt_16550_fifo_write(&_stdio_uart_handle, "\r", 1);
-    
-    alt_16550_fifo_write(&_stdio_uart_handle, ptr, 1);
-      
-    if (*ptr == '\r')
-      alt_16550_fifo_write(&_stdio_uart_handle, "\n", 1);
-      
-    level++;
-    ptr++;
-    rtn++;
+  while ((rtn = getchar_nb()) < 0)
+  {
+    if (timer_ticks() > timeout)
+      return -1;
   }
   
-  alt_16550_fifo_write(&_stdio_uart_handle, "\r\n", 2);
+  return rtn;
+}
+
+int write_raw(char *buf, int len)
+{
+  if (_stdio_uart_handle.device < 0)
+    return 0;
+  
+  stdio_tx(buf, len); // NOTE: Binary data is kept out of the log
+  
+  return len;
+}
+
+int puts(char *s)
+{
+  int rtn;
+  
+  rtn = strlen(s);
+  
+  stdio_write_text(s, rtn);
+  stdio_write("\r\n", 2);
   rtn++;
   
   return rtn;
 }
 
-int va_sprintf(char *s, char *f, va_list args)
+void stdio_sink_uart(stdio_sink_t *sink)
 {
-  char *s_ptr;
-  char *f_ptr;
+  stdio_write(sink->buf, sink->pos);
+  sink->pos = 0;
+}
+
+int vsnprintf(char *s, size_t n, char *f, va_list args)
+{
+  stdio_sink_t sink;
   int rtn;
-  int right_justify;
-  int zero_pad;
-  int field_width;
-  int long_arg;
-  char num_buf[32];
-  char *str;
-  int len;
-  int inum;
-  unsigned int unum;
-  int x, y;
   
-  s_ptr = s;
-  f_ptr = f;
-  rtn = 0;
+  // NOTE: Reserve room for the terminator, n == 0 (s may be null) only counts
+  sink.buf = s;
+  sink.pos = 0;
+  sink.size = (n > 0) ? (int) (n - 1) : 0;
+  sink.total = 0;
+  sink.drain = (void*)0;
   
-  while (*f_ptr != '\0')
-  {
-    if (*f_ptr == '%')
-    {
-      f_ptr++;
-      right_justify = 0;
-      zero_pad = 0;
-      field_width = 0;
-      long_arg = 0;
-      
-      if (*f_ptr == '%')
-      {
-        *s_ptr = *f_ptr;
-        f_ptr++;
-        s_ptr++;
-        continue;
-      }
-      
-      if (*f_ptr == '-')
-      {
-        right_justify = 1;
-        f_ptr++;
-      }
-      
-      while (*f_ptr == '0')
-      {
-        zero_pad = 1;
-        f_ptr++;
-      }
-      
-      while ((*f_ptr >= '0') && (*f_ptr <= '9'))
-      {
-        field_width *= 10;
-        field_width += *f_ptr - '0';
-        f_ptr++;
-      }
-
-      while ((*f_ptr == 'l') || (*f_ptr == 'L'))
-      {
-        long_arg++;
-        f_ptr++;
-      }
-            
-      if ((*f_ptr == 'd') || (*f_ptr == 'i'))
-      {
-        inum = va_arg(args, int);
-        if (inum == 0)
-          str = "0";
-        else
-        {
-          str = num_buf;
-          if (inum < 0)
-          {
-            inum = -inum;
-            *str = '-';
-            str++;
-          }
-          x = 1000000000;
-          while (x > 0)
-          {
-            y = inum / x;
-            inum -= (y * x);
-            x = x / 10;
-            *str = ((char) (y & 0xF)) + '0';
-            str++;
-          }
-          *str = '\0';
-          str = num_buf;
-          if (*str == '-')
-          {
-            str++;
-            while (*str == '0')
-              str++;
-            str--;
-            *str = '-';
-          }
-          else
-          {
-            while (*str == '0')
-              str++;
-          }
-        }
-        f_ptr++;
-      }
-      else if (*f_ptr == 'u')
-      {
-        unum = va_arg(args, unsigned int);
-        if (unum == 0)
-          str = "0";
-        else
-        {
-          str = num_buf;
-          x = 1000000000;
-          while (x > 0)
-          {
-            y = unum / x;
-            unum -= (y * x);
-            x = x / 10;
-            *str = ((char) (y & 0xF)) + '0';
-            str++;
-          }
-          *str = '\0';
-          str = num_buf;
-          while (*str == '0')
-            str++;
-        }
-        f_ptr++;
-      }
-      else if ((*f_ptr == 'x') || (*f_ptr == 'X') || (*f_ptr == 'p'))
-      {
-        if (*f_ptr == 'p')
-        {
-          field_width = 8;
-          zero_pad = 1;
-          unum = (unsigned int) va_arg(args, void *);
-        }
-        else
-          unum = va_arg(args, unsigned int);
-          
-        if (unum == 0)
-          str = "0";
-        else
-        {
-          str = num_buf;
-          for (x = 0; x < 8; x++)
-          {
-            *str = (char) ((unum >> 28) & 0xF);
-            *str += '0';
-            if (*str > '9')
-            {
-              *str += 7;
-              if (*f_ptr == 'x')
-                *str += 0x20;
-            }
-            str++;
-            unum = (unum << 4);            
-          }
-          *str = '\0';
-          str = num_buf;
-          while (*str == '0')
-            str++;
-        }
-        f_ptr++;
-      }
-      else if (*f_ptr == 's')
-      {
-        str = va_arg(args, char *);
-        f_ptr++;
-      }
-      else
-      {
-        str = "%BAD%";
-        f_ptr++;
-      }
-      
-      if (long_arg)
-      { str = "%BAD%"; }
-      
-      len = strlen(str);
-      if (right_justify || zero_pad)
-      {
-        while (len < field_width)
-        {
-          *s_ptr = (zero_pad) ? '0' : ' ';
-          s_ptr++;
-          rtn++;
-          len++;
-        }
-      }
-      while (*str != '\0')
-      {
-        *s_ptr = *str;
-        s_ptr++;
-        rtn++;
-        str++;
-      }
-      while (len < field_width)
-      {
-        *s_ptr = ' ';
-        s_ptr++;
-        rtn++;
-        len++;
-      }
-    }
-    else if (*f_ptr != '\0')
-    {
-      if (*f_ptr == '\n')
-      {
-        *s_ptr = '\r';
-        s_ptr++;
-        rtn++;
-      }
-      
-      *s_ptr = *f_ptr;
-      s_ptr++;
-      rtn++;
-      
-      if (*f_ptr == '\r')
-      {
-        *s_ptr = '\n';
-        s_ptr++;
-        rtn++;
-      }
-      
-      f_ptr++;
-    }
-  }
+  rtn = stdio_format(&sink, f, args);
+  
+  if (n > 0)
+    s[sink.pos] = '\0';
   
-  *s_ptr = '\0';
   return rtn;
 }
 
 int snprintf(char *s, size_t n, char *f, ...)
 {
+  int rtn;
   va_list args;
   va_start(args, f);
   
-  return va_sprintf(s, f, args);  
+  rtn = vsnprintf(s, n, f, args);
+  
+  va_end(args);
+  return rtn;
 }
 
 int sprintf(char *s, char *f, ...)
 {
+  int rtn;
   va_list args;
   va_start(args, f);
   
-  return va_sprintf(s, f, args);  
+  rtn = vsnprintf(s, 0x7FFFFFFF, f, args);
+  
+  va_end(args);
+  return rtn;
+}
+
+int vprintf(char *f, va_list args)
+{
+  stdio_sink_t sink;
+  char stage[64];
+  
+  sink.buf = stage;
+  sink.pos = 0;
+  sink.size = sizeof(stage);
+  sink.total = 0;
+  sink.drain = stdio_sink_uart;
+  
+  return stdio_format(&sink, f, args);
 }
 
 int printf(char *f, ...)
 {
-  char *ptr;
-  uint32_t level;
-  uint32_t fsize;
   int rtn;
-  char buf[256];
   va_list args;
   va_start(args, f);
-
-  if (_stdio_uart_handle.device < 0)
-    return 0;
-    
-  va_sprintf(buf, f, args);
   
-  alt_16550_fifo_size_get_tx(&_stdio_uart_handle, &fsize);
-  ptr = buf;
-  level = fsize;
-  rtn = 0;
-  
-  while (*ptr != '\0')
-  {
-    while (level >= fsize)
-    { alt_16550_fifo_level_get_tx(&_stdio_uart_handle, &level); }
-  
-    alt_16550_fifo_write(&_stdio_uart_handle, ptr, 1);
-    level++;
-    ptr++;
-    rtn++;
-  }
+  rtn = vprintf(f, args);
   
+  va_end(args);
   return rtn;
 }
 
-int simple_is_hexdigit(char *s)
+//
+// Number parsing
+// - One table lookup classifies a character and gives its digit value
+//
+
+const unsigned char simple_ctype[256] =
 {
-  if ((*s >= '0') && (*s <= '9'))
-    return 1;
-  
-  if ((*s >= 'A') && (*s <= 'F'))
-    return 1;
-    
-  if ((*s >= 'a') && (*s <= 'f'))
-    return 1;
-    
-  return 0;
-}
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x1F, 0x1F, // 00
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // 10
+  0x3F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // 20
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // 30
+  0x1F, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // 40
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // 50
+  0x1F, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // 60
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // 70
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // 80
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // 90
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // A0
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // B0
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // C0
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // D0
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, // E0
+  0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F // F0
+};
 
-char* simple_parse_number(char *s, int width, int *is_neg, unsigned int *n)
+unsigned int strtou32(const char *s, char **end, int base)
 {
+  const char *ptr;
   unsigned int unum;
-  char *s_ptr;
-  int base;
-  int x;
+  unsigned int limit;
+  unsigned int x;
+  int digits;
   
-  unum = 0;
-  *is_neg = 0;
-  s_ptr = s;
+  ptr = s;
+  
+  while (simple_isspace(*ptr))
+    ptr++;
   
-  while ((*s_ptr < '0') || (*s_ptr > '9'))
+  if ((ptr[0] == '0') && ((ptr[1] == 'x') || (ptr[1] == 'X')) &&
+      ((base == 0) || (base == 16)) && (simple_digit(ptr[2]) < 16))
   {
-    if (*s_ptr == '\0')
-      break;
-    
-    if (*s_ptr == '-')
-      *is_neg = 1;
-    else
-      *is_neg = 0;
-      
-    s_ptr++;
+    base = 16;
+    ptr += 2;
   }
-  if (*s_ptr != '0')
-    base = 10;
-  else if (*s_ptr != '\0')
+  else if (base == 0)
+    base = (ptr[0] == '0') ? 8 : 10;
+  
+  unum = 0;
+  digits = 0;
+  limit = 0xFFFFFFFF / base;
+  
+  while ((x = simple_digit(*ptr)) < (unsigned int) base)
   {
-    s_ptr++;
-    if ((*s_ptr == 'x') || (*s_ptr == 'X'))
-    {
-      base = 16;
-      s_ptr++;
-    }
+    // NOTE: Saturates on overflow, like strtoul()
+    if ((unum > limit) || ((unum * base) > (0xFFFFFFFF - x)))
+      unum = 0xFFFFFFFF;
     else
-      base = 8;
-  }       
-  while (simple_is_hexdigit(s_ptr) && (width > 0))
-  {
-    x = (*s_ptr - '0');
-    if (x > 9)
-      x = (x - 7) & 0xF;
-    if (x >= base)
-      break;
-    unum *= base;
-    unum += x;
-    s_ptr++;
-    width--;
+      unum = (unum * base) + x;
+    
+    ptr++;
+    digits++;
   }
   
-  *n = unum;
-  return s_ptr;
+  if (end != (char**)0)
+    *end = (char*) ((digits) ? ptr : s);
+  
+  return unum;
+}
+
+int strtos32(const char *s, char **end, int base)
+{
+  const char *ptr;
+  unsigned int unum;
+  int is_neg;
+  
+  ptr = s;
+  
+  while (simple_isspace(*ptr))
+    ptr++;
+  
+  is_neg = (*ptr == '-');
+  
+  if ((*ptr == '-') || (*ptr == '+'))
+    ptr++;
+  
+  unum = strtou32(ptr, end, base);
+  
+  if ((end != (char**)0) && (*end == ptr))
+    *end = (char*) s;
+  
+  // NOTE: Saturate to the signed range before the sign goes on
+  if (is_neg)
+    return (unum >= 0x80000000) ? (int) 0x80000000 : -((int) unum);
+  
+  return (unum > 0x7FFFFFFF) ? 0x7FFFFFFF : (int) unum;
 }
 
+// NOTE: Like the C library, but %d %i and %u all accept 0x (hex) and 0 (octal) prefixes
 int sscanf(char *s, char *f, ...)
 {
   char *s_ptr;
   char *f_ptr;
+  char *end;
+  char num_buf[33];
   int field_width;
-  int long_arg;
-  int inum;
-  int is_neg;
-  unsigned int unum;
+  int is_signed;
   int base;
+  int x;
   char *str;
   int rtn;
   
@@ -617,108 +921,155 @@ int sscanf(char *s, char *f, ...)
 
   while (*f_ptr != '\0')
   {
-    while (*s_ptr == ' ')
-      s_ptr++;
+    if (simple_isspace(*f_ptr))
+    {
+      while (simple_isspace(*f_ptr))
+        f_ptr++;
+      
+      while (simple_isspace(*s_ptr))
+        s_ptr++;
       
-    while (*f_ptr == ' ')
+      continue;
+    }
+    
+    if (*f_ptr != '%')
+    {
+      if (*s_ptr != *f_ptr)
+        break;
+      
+      s_ptr++;
       f_ptr++;
-  
+      continue;
+    }
+    
+    f_ptr++;
+    
     if (*f_ptr == '%')
     {
-      f_ptr++;
-      field_width = 0;
-      long_arg = 0;
+      if (*s_ptr != '%')
+        break;
       
-      while ((*f_ptr >= '0') && (*f_ptr <= '9'))
-      {
-        field_width *= 10;
-        field_width += *f_ptr - '0';
-        f_ptr++;
-      }
+      s_ptr++;
+      f_ptr++;
+      continue;
+    }
+    
+    field_width = 0;
+    
+    while (simple_digit(*f_ptr) < 10)
+    {
+      field_width *= 10;
+      field_width += *f_ptr - '0';
+      f_ptr++;
+    }
 
-      while ((*f_ptr == 'l') || (*f_ptr == 'L'))
-      {
-        long_arg++;
-        f_ptr++;
-      }
+    while ((*f_ptr == 'l') || (*f_ptr == 'L'))
+      f_ptr++;
+    
+    while (simple_isspace(*s_ptr))
+      s_ptr++;
+    
+    if (*f_ptr == 's')
+    {
+      if (*s_ptr == '\0')
+        break;
       
-      if ((*f_ptr == 'd') || (*f_ptr == 'i'))
-      {
-        if (field_width == 0)
-          field_width = 8;
-
-        s_ptr = simple_parse_number(s_ptr, field_width, &is_neg, &unum);
-        
-        inum = (int) unum;
-        if (is_neg)
-          inum = -inum;
-          
-        *va_arg(args, int *) = inum;
-        rtn++;
-        f_ptr++;
-      } 
-      else if (*f_ptr == 'u')
+      str = va_arg(args, char *);
+      
+      // NOTE: No width means no limit (field_width goes negative)
+      while ((*s_ptr != '\0') && !simple_isspace(*s_ptr))
       {
-        if (field_width == 0)
-          field_width = 8;
+        *(str++) = *(s_ptr++);
         
-        s_ptr = simple_parse_number(s_ptr, field_width, &is_neg, &unum);
-          
-        *va_arg(args, unsigned int *) = unum;
-        rtn++;
-        f_ptr++;
-      }
-      else if ((*f_ptr == 'x') || (*f_ptr == 'X'))
-      {
-        unum = 0;
-        while ((*s_ptr < '0') || (*s_ptr > 'f'))
-        {
-          if (*s_ptr == '\0')
-            break;
-          s_ptr++;
-        }  
-        while (simple_is_hexdigit(s_ptr) && (field_width > 0))
-        {
-          unum *= 16;
-          inum = (*s_ptr - '0');
-          if (inum > 9)
-            inum = (inum - 7) & 0xF;
-          unum += inum;
-          s_ptr++;
-          field_width--;
-        }
-        *va_arg(args, unsigned int *) = unum;
-        rtn++;
-        f_ptr++;
-      }
-      else if (*f_ptr == 's')
-      {
-        if (field_width == 0)
-          field_width = 512;
-        str = va_arg(args, char *);
-        rtn++;
-        f_ptr++;
-        while ((*s_ptr != *f_ptr) && (field_width > 0))
-        {
-          *str = *s_ptr;
-          if (*s_ptr == '\0')
-            break;
-          str++;
-          s_ptr++;
-          field_width--;
-        }
-        *str = '\0';
+        if (--field_width == 0)
+          break;
       }
+      
+      *str = '\0';
+      rtn++;
+      f_ptr++;
+      continue;
     }
-    else if (*s_ptr == *f_ptr)
+    
+    if ((*f_ptr == 'd') || (*f_ptr == 'i'))
     {
-      s_ptr++;
-      f_ptr++;
+      is_signed = 1;
+      base = 0;
+    }
+    else if (*f_ptr == 'u')
+    {
+      is_signed = 0;
+      base = 0;
+    }
+    else if ((*f_ptr == 'x') || (*f_ptr == 'X'))
+    {
+      is_signed = 0;
+      base = 16;
     }
     else
       break;
+    
+    f_ptr++;
+    
+    // NOTE: A width limits how much of the input is looked at
+    if ((field_width > 0) && (field_width < (int) sizeof(num_buf)))
+    {
+      for (x = 0; (x < field_width) && (s_ptr[x] != '\0'); x++)
+        num_buf[x] = s_ptr[x];
+      
+      num_buf[x] = '\0';
+      str = num_buf;
+    }
+    else
+      str = s_ptr;
+    
+    if (is_signed)
+      *va_arg(args, int *) = strtos32(str, &end, base);
+    else
+      *va_arg(args, unsigned int *) = strtou32(str, &end, base);
+    
+    if (end == str)
+      break;
+    
+    s_ptr += end - str;
+    rtn++;
   }
   
+  va_end(args);
   return rtn;
 }
 
+BOOT_STEP(160, stdio_irq_init, "interrupt driven stdio output");
+BOOT_STEP(1840, stdio_irq_uninit, "back to polled stdio output");
+
+int stdio_dmesg(int argc, char** argv)
+{
+  unsigned int from;
+  
+  if ((argc == 2) && (strcmp(argv[1], "clear") == 0))
+  {
+    stdio_log_start = stdio_log_head;
+    return 0;
+  }
+  else if (argc != 1)
+  {
+    puts("ERROR: Invalid argument");
+    return -1;
+  }
+  
+  from = stdio_log_start;
+  
+  // NOTE: Once the ring has wrapped, start at the first whole line
+  if ((stdio_log_head - from) > STDIO_LOG_SIZE)
+  {
+    from = stdio_log_head - STDIO_LOG_SIZE;
+    
+    while ((from != stdio_log_head) && (stdio_log[(from++) & STDIO_LOG_MASK] != '\n'));
+  }
+  
+  stdio_log_send(from);
+  
+  return 0;
+}
+
+TERMINAL_COMMAND("dmesg", stdio_dmesg, "[clear] Show stdio output since boot");
@@ -38,6 +38,9 @@ void alt_int_handler_irq(); // NOTE: Defined in alt_interrupt.c, but not in head
 extern int stack_svc_block; // NOTE: Defined in linker script
 extern int stack_irq_block;
 extern int stack_abt_block;
+extern int stack_svc1_block; // NOTE: Separate stacks for CPU1 (see cpu1.c)
+extern int stack_irq1_block;
+extern int stack_abt1_block;
 
 __attribute__((section(".pimage_hdr"))) int pimage_header[5];
 
@@ -84,8 +87,20 @@ __attribute__((naked, section(".vector"))) void _vector_table()
 extern int _bss_start;
 extern int _bss_end;
 
+void cpu1_main(); // NOTE: Defined in cpu1.c
+
+__attribute__((naked, noreturn, section(".startup"))) void _startup_cpu1();
+
 __attribute__((naked, noreturn, section(".startup"))) void _startup()
 { 
+  //
+  // CPU1 comes here as well once released from reset
+  //
+  
+  __asm("MRC p15, 0, r0, c0, c0, 5;\n");
+  __asm("ands r0, r0, #3;\n");
+  __asm("bne _startup_cpu1;\n");
+  
   //
   // Move vector table to start of OCRAM
   //
@@ -119,7 +134,7 @@ __attribute__((naked, noreturn, section(".startup"))) void _startup()
   // Clear BSS
   //
   
-  memset((void*)&_bss_start, 0, (int) (&_bss_end - &_bss_start));
+  memset((void*)&_bss_start, 0, (int) &_bss_end - (int) &_bss_start);
   
   //
   // Run boot sequence, main, and then shutdown sequence
@@ -132,3 +147,42 @@ __attribute__((naked, noreturn, section(".startup"))) void _startup()
   while(1);
 }
 
+__attribute__((naked, noreturn, section(".startup"))) void _startup_cpu1()
+{ 
+  //
+  // Share the vector table in OCRAM with CPU0
+  //
+  
+  __asm("MRC p15, 0, r0, c1, c0, 0;\n");
+  __asm("bic r0, #(1 << 13);\n");
+  __asm("MCR p15, 0, r0, c1, c0, 0;\n");
+  __asm("ldr r0, =_start;\n");
+  __asm("MCR p15, 0, r0, c12, c0, 0;\n");
+  
+  //
+  // Initialize stack registers (CPU1 has its own set)
+  //
+  
+  __asm("mrs r0, cpsr;\n");
+  __asm("and r0, r0, #0xFFFFFFE0;\n");
+  
+  __asm("orr r1, r0, #0x17;\n");
+  __asm("msr cpsr, r1;\n");
+  __asm("ldr sp, =(stack_abt1_block - 16);\n");
+    
+  __asm("orr r1, r0, #0x12;\n");
+  __asm("msr cpsr, r1;\n");
+  __asm("ldr sp, =(stack_irq1_block - 16);\n");
+  
+  __asm("orr r1, r0, #0x13;\n");
+  __asm("msr cpsr, r1;\n");
+  __asm("ldr sp, =(stack_svc1_block - 16);\n");
+  
+  //
+  // Run jobs handed over by CPU0 (never returns)
+  //
+  
+  cpu1_main();
+  
+  while(1);
+}
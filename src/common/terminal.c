@@ -30,14 +30,19 @@ SOFTWARE.
 #include <string.h>
 #include "simple_stdio.h"
 #include "terminal.h"
-
-extern void _startup();
+#include "cpu1.h"
+#include "boot.h"
+#ifdef TERMINAL_HASH_H
+#include TERMINAL_HASH_H // NOTE: The host build has its own (smaller) command table
+#else
+#include "terminal_hash.h" // NOTE: Generated by makefile
+#endif
 
 //
 // NULL entry for terminal command table in memory
 //
 
-__attribute__((section(".terminal_cmd_null"))) terminal_cmd_t terminal_null_cmd_entry = 
+__attribute__((section(".terminal_cmd_null"))) const terminal_cmd_t terminal_null_cmd_entry = 
   {
     .name = (char*)0,
     .entry = (void*)0,
@@ -45,50 +50,46 @@ __attribute__((section(".terminal_cmd_null"))) terminal_cmd_t terminal_null_cmd_
   };
 
 //
-// Bubble sort from A-Z
-// - Cleanup for 'help', so that commands are displayed in alphebetical order
-// - Needed because the table is built by the linker and order might seem random
+// Find a command
+// - Table is sorted by the linker, hash index is made by src/tools/terminal_hash.c
+// - Falls back to a binary search if the hash misses, so a command the generator did
+//   not see (i.e. stale terminal_hash.h) is still found
 //
-  
-void terminal_sort_cmds()
+
+const terminal_cmd_t *terminal_find_cmd(char *name)
 {
-  terminal_cmd_t *cmd;
-  terminal_cmd_t *cmd_next;
-  terminal_cmd_t tmp;
-  int keep_going;
+  const terminal_cmd_t *cmd;
+  int count;
+  int idx;
+  int lo;
+  int hi;
+  int rtn;
+  
+  count = terminal_cmds_end - terminal_cmds;
+  
+  idx = terminal_hash_index[terminal_hash(name, TERMINAL_HASH_SEED) & (TERMINAL_HASH_SIZE - 1)];
+  
+  if ((idx < count) && (strcmp(name, terminal_cmds[idx].name) == 0))
+    return &terminal_cmds[idx];
+  
+  lo = 0;
+  hi = count - 1;
   
-  keep_going = 1;
-  while (keep_going)
+  while (lo <= hi)
   {
-    keep_going = 0;
-    cmd = terminal_cmds;
-    cmd_next = cmd + 1;
+    idx = (lo + hi) / 2;
+    cmd = &terminal_cmds[idx];
+    rtn = strcmp(name, cmd->name);
     
-    while (cmd_next->name != (char*)0)
-    {
-      if (strcmp(cmd->name, cmd_next->name) > 0)
-      {
-        keep_going = 1;
-        
-        tmp.name = cmd->name;
-        tmp.entry = cmd->entry;
-        tmp.help = cmd->help;
-        
-        cmd->name = cmd_next->name;
-        cmd->entry = cmd_next->entry;
-        cmd->help = cmd_next->help;
-        
-        cmd_next->name = tmp.name;
-        cmd_next->entry = tmp.entry;
-        cmd_next->help = tmp.help;
-      }
-      
-      cmd++;
-      cmd_next++;
-    }  
+    if (rtn == 0)
+      return cmd;
+    else if (rtn < 0)
+      hi = idx - 1;
+    else
+      lo = idx + 1;
   }
   
-  return;
+  return (terminal_cmd_t*)0;
 }
 
 //
@@ -143,14 +144,12 @@ int terminal_mkarg(char* line, char** argv, int max)
 void terminal()
 {
   int x;
-  terminal_cmd_t *cmd;
+  const terminal_cmd_t *cmd;
   char buf[256];
   char* argv[16];
   int argc;
   int rtn;
   
-  terminal_sort_cmds();
-  
   printf("\n>> ");
   while (1)
   {
@@ -162,18 +161,15 @@ void terminal()
       if (strcmp(argv[0], "exit") == 0)
         break;
       else if (strcmp(argv[0], "restart") == 0)
-        _startup();
-
-      cmd = terminal_cmds;
-      while (cmd->name != (char*)0)
       {
-        if (strcmp(argv[0], cmd->name) == 0)
-          break;
-
-        cmd++;
+        flush();
+        cpu1_stop(0);
+        boot_restart((argc < 2) || (strcmp(argv[1], "cold") != 0));
       }
 
-      if (cmd->name == (char*)0)
+      cmd = terminal_find_cmd(argv[0]);
+
+      if (cmd == (terminal_cmd_t*)0)
         printf("ERROR: Invalid command '%s' - try 'help'\n", argv[0]);
       else
         rtn = cmd->entry(argc, argv);
@@ -31,10 +31,11 @@ SOFTWARE.
 #include "simple_stdio.h"
 #include "terminal.h"
 #include "boot.h"
+#include "timer.h"
 
 int terminal_help(int argc, char** argv)
 {
-  terminal_cmd_t *cmd;
+  const terminal_cmd_t *cmd;
   
   puts("\n --- Terminal HELP ---\n");
 
@@ -50,7 +51,7 @@ int terminal_help(int argc, char** argv)
   if (argc <= 1)
   {
     printf("\n  %-16s : %s\n", "exit", "exit from terminal");
-    printf("  %-16s : %s\n", "restart", "call _startup() to start over");
+    printf("  %-16s : %s\n", "restart", "[cold] start over, skipping completed steps unless 'cold'");
   }
 
   return 0;
@@ -67,6 +68,7 @@ int terminal_read(int argc, char** argv)
   short as_half;
   int as_word;
   int abt_data_old;
+  char *end;
   
   if (argc != 3)
   {
@@ -74,7 +76,8 @@ int terminal_read(int argc, char** argv)
     return -1;
   }
   
-  if (sscanf(argv[2], "%u", &addr) != 1)
+  addr = strtou32(argv[2], &end, 0);
+  if ((end == argv[2]) || (*end != '\0'))
   {
     puts("ERROR: Second argument must be an unsigned number");
     return -2;
@@ -133,6 +136,7 @@ int terminal_dump(int argc, char** argv)
   unsigned int as_word;
   int abt_data_old;
   char estr[17];
+  char *end;
   
   if (argc != 4)
   {
@@ -140,13 +144,15 @@ int terminal_dump(int argc, char** argv)
     return -1;
   }
   
-  if (sscanf(argv[2], "%u", &addr) != 1)
+  addr = strtou32(argv[2], &end, 0);
+  if ((end == argv[2]) || (*end != '\0'))
   {
     puts("ERROR: Second argument must be an unsigned number");
     return -2;
   }
 
-  if (sscanf(argv[3], "%u", &cnt) != 1)
+  cnt = strtou32(argv[3], &end, 0);
+  if ((end == argv[3]) || (*end != '\0'))
   {
     puts("ERROR: Third argument must be an unsigned number");
     return -3;
@@ -183,7 +189,12 @@ int terminal_dump(int argc, char** argv)
       cnt--;
       
       if ((addr & 0xF) == 0)
+      {
         printf(" | %s |\n %08X : ", estr, addr);
+        
+        if (ctrlc())
+          cnt = 0; // NOTE: Stop at the end of a line
+      }
     }
   
     if (addr & 0xF)
@@ -222,7 +233,12 @@ int terminal_dump(int argc, char** argv)
       cnt--;
       
       if ((addr & 0x1F) == 0)
+      {
         printf("\n %08X : ", addr);
+        
+        if (ctrlc())
+          cnt = 0; // NOTE: Stop at the end of a line
+      }
     }
     printf("\n");
   }
@@ -248,7 +264,12 @@ int terminal_dump(int argc, char** argv)
       cnt--;
       
       if ((addr & 0x1F) == 0)
+      {
         printf("\n %08X : ", addr);
+        
+        if (ctrlc())
+          cnt = 0; // NOTE: Stop at the end of a line
+      }
     }
     printf("\n");
   }
@@ -267,6 +288,7 @@ int terminal_write(int argc, char** argv)
   unsigned int addr;
   unsigned int data;
   int abt_data_old;
+  char *end;
   
   if (argc < 4)
   {
@@ -274,7 +296,8 @@ int terminal_write(int argc, char** argv)
     return -1;
   }
   
-  if (sscanf(argv[2], "%u", &addr) != 1)
+  addr = strtou32(argv[2], &end, 0);
+  if ((end == argv[2]) || (*end != '\0'))
   {
     puts("ERROR: Second argument must be an unsigned number");
     return -2;
@@ -282,7 +305,8 @@ int terminal_write(int argc, char** argv)
 
   for (x = 3; x < argc; x++)
   {
-    if (sscanf(argv[x], "%u", &data) != 1)
+    data = strtou32(argv[x], &end, 0);
+    if ((end == argv[x]) || (*end != '\0'))
     {
       printf("ERROR: Argument %i must be an unsigned number\n", x);
       return -3;
@@ -338,66 +362,110 @@ int terminal_write(int argc, char** argv)
   return 0;
 }
 
+void terminal_boot_step_show(boot_step_t *boot_step)
+{
+  if (boot_step->deps == (char*)0)
+    printf(" %-4i : %-3i : %s\n", boot_step->step, boot_step->level, boot_step->desc);
+  else
+    printf(" %-4i : %-3i : %s (after: %s)\n", boot_step->step, boot_step->level, boot_step->desc, boot_step->deps);
+  
+  return;
+}
+
 int terminal_boot_steps(int argc, char** argv)
 {
-  int step_num;
-  int hflag;
   boot_step_t *boot_step;
   
-  hflag = 1;
-  for (step_num = 1; step_num < 1000; step_num++)
+  boot_schedule(); // NOTE: Also reports any problems with prerequisites
+  
+  puts("\nBoot (1 - 999)");
+  puts(" Step : Lvl : description");
+  
+  boot_step = boot_sequence;
+  while ((boot_step != (boot_step_t*)0) && (boot_step->step < 1000))
   {
-    boot_step = boot_steps;   
-    while (boot_step->desc != (char*)0)
-    {
-      if (boot_step->step == step_num)
-      {
-        if (hflag)
-        {
-          hflag = 0;
-          puts("\nBoot (1 - 999)");
-        }
-        printf(" %-4i : %s\n", step_num, boot_step->desc);
-      }
-      boot_step++;
-    }
+    terminal_boot_step_show(boot_step);
+    boot_step = boot_step->next;
   }
 
-  hflag = 1;
-  for (step_num = 1000; step_num < 2000; step_num++)
+  puts("\nShutdown (1000 - 1999)");
+  puts(" Step : Lvl : description");
+  
+  while (boot_step != (boot_step_t*)0)
   {
-    boot_step = boot_steps;   
-    while (boot_step->desc != (char*)0)
-    {
-      if (boot_step->step == step_num)
-      {
-        if (hflag)
-        {
-          hflag = 0;
-          puts("\nShutdown (1000 - 1999)");
-        }
-        printf(" %-4i : %s\n", step_num, boot_step->desc);
-      }
-      boot_step++;
-    }
+    terminal_boot_step_show(boot_step);
+    boot_step = boot_step->next;
   }
   
-  hflag = 1;
-  boot_step = boot_steps;
-  while (boot_step->desc != (char*)0)
+  puts("\nNOTE: Steps with the same level do not depend on each other");
+    
+  return 0;
+}
+
+char *terminal_boot_step_status(boot_step_t *boot_step)
+{
+  if (boot_step->skipped)
+    return "skipped, warm restart";
+  
+  switch (boot_step->status)
   {
-    if ((boot_step->step < 1) || (boot_step->step > 1999))
-    {
-      if (hflag)
-      {
-        hflag = 0;
-        puts("\nNot Used (others)");
-      }
-      printf(" %-4i : %s\n", boot_step->step, boot_step->desc);
-    }
-    boot_step++;
+  case 0: return "";
+  case BOOT_BUSY: return "running";
+  case BOOT_TIMEOUT: return "out of time";
+  case BOOT_BLOCKED: return "skipped, prerequisite failed";
+  case BOOT_NOT_RUN: return "not run";
+  default: return "FAILED";
   }
+}
+
+//
+// NOTE: 'usec' is the step entry and 'overlap' its asynchronous work, which runs
+//       alongside later steps. 'at' is when the entry returned, from the start of
+//       boot(). Shares are of the wall clock boot time, so they add up to 100% or less.
+//
+
+int terminal_boot_profile(int argc, char** argv)
+{
+  boot_step_t *boot_step;
+  unsigned long long end;
+  unsigned int total;
+  unsigned int at;
+  unsigned int share;
+  
+  end = (boot_end_ticks != 0) ? boot_end_ticks : timer_ticks();
+  total = timer_ticks_to_us(end - boot_start_ticks);
+  
+  if (total == 0)
+    total = 1;
+  
+  puts("\n Step :      ticks :       usec :    overlap :    at usec :  share : description");
+  
+  boot_step = boot_sequence;
+  while ((boot_step != (boot_step_t*)0) && (boot_step->step < 1000))
+  {
+    at = 0;
+    
+    if ((boot_step->status != BOOT_NOT_RUN) && !boot_step->skipped)
+      at = timer_ticks_to_us(boot_step->start - boot_start_ticks) + boot_step->entry_usec;
     
+    share = (unsigned int) (((unsigned long long) boot_step->entry_usec * 1000) / total);
+    
+    printf(" %-4i : %-10llu : %-10u : %-10u : %-10u : %-3u.%u%% : %s", boot_step->step, boot_step->ticks, 
+      boot_step->entry_usec, boot_step->usec - boot_step->entry_usec, at, share / 10, share % 10, boot_step->desc);
+    
+    if (boot_step->skipped || (boot_step->status != 0))
+      printf(" (%s)", terminal_boot_step_status(boot_step));
+    
+    if (boot_step->budget_us != 0)
+      printf(" [budget %u usec]", boot_step->budget_us);
+    
+    puts("");
+    boot_step = boot_step->next;
+  }
+  
+  printf("\n Total boot time = %u usec (%u ticks per usec, %s boot)\n", total, 
+    timer_ticks_per_us(), (boot_warm) ? "warm" : "cold");
+  
   return 0;
 }
 
@@ -410,6 +478,8 @@ extern int _data_start;
 extern int _data_end;
 extern int _bss_start;
 extern int _bss_end;
+extern int _retained_start;
+extern int _retained_end;
 extern int _stack_start;
 extern int _stack_end;
   
@@ -431,6 +501,9 @@ int terminal_mem_usage(int argc, char** argv)
   sz = (int) &_bss_end - (int) &_bss_start;
   printf("    BSS = %-8i (%08X - %08X)\n", sz, (int) &_bss_start, (int) &_bss_end);
   
+  sz = (int) &_retained_end - (int) &_retained_start;
+  printf(" RETAIN = %-8i (%08X - %08X)\n", sz, (int) &_retained_start, (int) &_retained_end);
+  
   sz = (int) &_stack_end - (int) &_stack_start;
   printf("  STACK = %-8i (%08X - %08X)\n", sz, (int) &_stack_start, (int) &_stack_end);
   
@@ -441,11 +514,92 @@ int terminal_mem_usage(int argc, char** argv)
   return 0;
 }
 
+//
+// Switch the UART baud rate, the new rate must be confirmed by pressing Enter at
+// that rate or it falls back to the old one
+//
+
+#define BAUD_CONFIRM_USEC 10000000
+
+int terminal_baud(int argc, char** argv)
+{
+  unsigned int old_baud;
+  unsigned int baud;
+  unsigned long long timeout;
+  int rtn;
+  int c;
+  char *end;
+  
+  if (argc == 1)
+  {
+    printf("  Baud rate = %u (max %u)\n", stdio_baudrate, stdio_baudrate_max());
+    return 0;
+  }
+  
+  if (argc != 2)
+  {
+    puts("ERROR: Invalid number of arguments");
+    return -1;
+  }
+  
+  if (strcmp(argv[1], "max") == 0)
+    baud = stdio_baudrate_max();
+  else
+  {
+    baud = strtou32(argv[1], &end, 10);
+    
+    if ((end == argv[1]) || (*end != '\0'))
+    {
+      puts("ERROR: Invalid baud rate");
+      return -2;
+    }
+  }
+  
+  if (stdio_baudrate_actual(baud) == 0)
+  {
+    printf("ERROR: UART clock can not make %u baud (max %u)\n", baud, stdio_baudrate_max());
+    return -3;
+  }
+  
+  old_baud = stdio_baudrate;
+  
+  printf("  Switching to %u baud (actual %u), press Enter at the new rate within %u sec\n", 
+    baud, stdio_baudrate_actual(baud), BAUD_CONFIRM_USEC / 1000000);
+  
+  rtn = stdio_baudrate_set(baud);
+  
+  if (rtn != 0)
+  {
+    printf("ERROR: Unable to set baud rate, error code (%i)\n", rtn);
+    return -4;
+  }
+  
+  // NOTE: Anything but Enter (i.e. noise from the switch) is ignored
+  timeout = timer_ticks() + ((unsigned long long) timer_ticks_per_us() * BAUD_CONFIRM_USEC);
+  
+  do
+  {
+    c = getchar_nb();
+  } while ((c != '\r') && (c != '\n') && (timer_ticks() < timeout));
+  
+  if ((c == '\r') || (c == '\n'))
+  {
+    printf("  Baud rate is now %u\n", baud);
+    return 0;
+  }
+  
+  stdio_baudrate_set(old_baud);
+  printf("ERROR: No confirmation, back to %u baud\n", old_baud);
+  
+  return -5;
+}
 
 TERMINAL_COMMAND("help", terminal_help, "[command]");
 TERMINAL_COMMAND("read", terminal_read, "{b|h|w} {address}");
 TERMINAL_COMMAND("dump", terminal_dump, "{b|h|w} {address count}");
 TERMINAL_COMMAND("write", terminal_write, "{b|h|w} {address data} [data ...]");
 TERMINAL_COMMAND("boot-steps", terminal_boot_steps, "Show boot steps in sequence order");
+TERMINAL_COMMAND("boot-profile", terminal_boot_profile, "Show time spent in each boot step");
 TERMINAL_COMMAND("memory-usage", terminal_mem_usage, "Show memory usage");
+TERMINAL_COMMAND("baud", terminal_baud, "[rate | max] (confirm with Enter at the new rate)");
 
@@ -0,0 +1,79 @@
+/*
+  Free running timer based on the Cortex-A9 global timer
+  (used for boot step profiling and other measurements)
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include "alt_globaltmr.h"
+#include "alt_clock_manager.h"
+#include "timer.h"
+
+//
+// Start the global timer (if the bootrom or a previous boot did not already)
+//
+
+void timer_init()
+{
+  if (!alt_globaltmr_is_running())
+  {
+    alt_globaltmr_init();
+    alt_globaltmr_start();
+  }
+  
+  return;
+}
+
+unsigned long long timer_ticks()
+{ return alt_globaltmr_get64(); }
+
+//
+// NOTE: Global timer runs from mpu_periph clock, so this changes with clock settings
+//
+
+unsigned int timer_ticks_per_us()
+{
+  uint32_t freq;
+  
+  if (alt_clk_freq_get(ALT_CLK_MPU_PERIPH, &freq) != ALT_E_SUCCESS)
+    return 1;
+  
+  freq = freq / (alt_globaltmr_prescaler_get() + 1);
+  freq = freq / 1000000;
+  
+  if (freq == 0)
+    return 1;
+  
+  return freq;
+}
+
+unsigned int timer_ticks_to_us(unsigned long long ticks)
+{
+  ticks = ticks / timer_ticks_per_us();
+  
+  if (ticks > 0xFFFFFFFF)
+    return 0xFFFFFFFF;
+  
+  return (unsigned int) ticks;
+}
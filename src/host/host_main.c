@@ -0,0 +1,359 @@
+/*
+  Host build entry point for 'make host-test'
+  
+    host_bmx bench              : printf throughput, command dispatch and SD file lookup
+    host_bmx [-i card.img] term : interactive terminal on stdin/stdout
+  
+  Without '-i' a small card is built in memory: an MBR with one A2 partition and a
+  'make sdcard' style file header after the preloader image. The benchmark always
+  uses this card, so it can check where each file was found.
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "alt_16550_uart.h"
+#include "simple_stdio.h"
+#include "terminal.h"
+#include "timer.h"
+#include "log.h"
+
+extern ALT_16550_HANDLE_t _stdio_uart_handle;
+
+extern int host_uart_quiet;
+extern unsigned long long host_uart_bytes;
+extern char *host_uart_capture;
+extern size_t host_uart_capture_size;
+extern size_t host_uart_captured;
+extern unsigned long long host_card_reads;
+void host_card_set(const unsigned char *data, size_t size);
+
+int sd_card_init(int step);
+int sd_find_file(char *filename, int *sector, int *bytes);
+int log_dump(int argc, char** argv);
+
+//
+// Card setup
+//
+
+#define HOST_PART_START 1   // First sector of the A2 partition
+#define HOST_FILES 16       // NOTE: All header lines must fit in one 512 byte sector
+
+int host_file_bytes(int x)
+{ return 1000 + (x * 700); }
+
+int host_file_sectors(int bytes)
+{ return (bytes + 511) >> 9; }
+
+void host_card_build()
+{
+  unsigned char *card;
+  size_t size;
+  char *hdr;
+  int sectors;
+  int pos;
+  int x;
+  
+  sectors = 0;
+  for (x = 0; x < HOST_FILES; x++)
+    sectors += host_file_sectors(host_file_bytes(x));
+  
+  size = (HOST_PART_START + 0x801 + sectors) * 512;
+  card = calloc(1, size);
+  
+  if (card == NULL)
+    exit(1);
+  
+  // MBR, first partition entry
+  card[0x1BE + 4] = 0xA2;
+  card[0x1BE + 8] = HOST_PART_START;
+  card[0x1BE + 12] = (size >> 9) & 0xFF;
+  card[0x1BE + 13] = (size >> 17) & 0xFF;
+  card[0x1BE + 14] = (size >> 25) & 0xFF;
+  card[510] = 0x55;
+  card[511] = 0xAA;
+  
+  // File header, one "> {name} [{bytes}]" line per file
+  hdr = (char*) &card[(HOST_PART_START + 0x800) * 512];
+  pos = 0;
+  
+  for (x = 0; x < HOST_FILES; x++)
+    pos += snprintf(&hdr[pos], 511 - pos, "> file%03i.dat [%i]\n", x, host_file_bytes(x));
+  
+  host_card_set(card, size);
+  free(card);
+}
+
+int host_card_load(char *filename)
+{
+  struct stat st;
+  unsigned char *card;
+  int fd;
+  
+  fd = open(filename, O_RDONLY);
+  
+  if ((fd < 0) || (fstat(fd, &st) != 0))
+  {
+    printf("ERROR: Unable to open '%s'\n", filename);
+    return -1;
+  }
+  
+  card = malloc(st.st_size);
+  
+  if ((card == NULL) || (read(fd, card, st.st_size) != st.st_size))
+  {
+    printf("ERROR: Unable to read '%s'\n", filename);
+    close(fd);
+    return -1;
+  }
+  
+  close(fd);
+  host_card_set(card, st.st_size);
+  free(card);
+  return 0;
+}
+
+//
+// Benchmarks
+//
+
+#define BENCH_PRINTF_LOOPS 200000
+#define BENCH_CMD_LOOPS 200000
+#define BENCH_FILE_LOOPS 20000
+
+int bench_printf()
+{
+  unsigned long long start;
+  unsigned long long bytes;
+  unsigned int us;
+  int x;
+  
+  host_uart_quiet = 1;
+  bytes = host_uart_bytes;
+  start = timer_ticks();
+  
+  for (x = 0; x < BENCH_PRINTF_LOOPS; x++)
+    printf("%i: 0x%08x %s %-10llu\n", x, x * 0x9E3779B9u, "sd-dump", 123456789012ull + x);
+  
+  us = timer_ticks_to_us(timer_ticks() - start);
+  bytes = host_uart_bytes - bytes;
+  host_uart_quiet = 0;
+  
+  if (us == 0)
+    us = 1;
+  
+  printf("printf   : %i calls, %llu bytes in %u us (%llu KB/s, %u ns/call)\n", BENCH_PRINTF_LOOPS, 
+    bytes, us, (bytes * 1000000ull) / ((unsigned long long) us * 1024), (us * 1000u) / BENCH_PRINTF_LOOPS);
+  return 0;
+}
+
+int bench_cmds()
+{
+  static char *misses[] = {"nope", "sd-filez", "m", "help2", ""};
+  const terminal_cmd_t *cmd;
+  unsigned long long start;
+  unsigned int us;
+  int count;
+  int found;
+  int x;
+  
+  count = terminal_cmds_end - terminal_cmds;
+  
+  for (cmd = terminal_cmds; cmd < terminal_cmds_end; cmd++)
+  {
+    if (terminal_find_cmd(cmd->name) != cmd)
+    {
+      printf("ERROR: Command '%s' not found\n", cmd->name);
+      return -1;
+    }
+  }
+  
+  for (x = 0; x < (sizeof(misses) / sizeof(misses[0])); x++)
+  {
+    if (terminal_find_cmd(misses[x]) != NULL)
+    {
+      printf("ERROR: Command '%s' should not be found\n", misses[x]);
+      return -1;
+    }
+  }
+  
+  found = 0;
+  start = timer_ticks();
+  
+  for (x = 0; x < BENCH_CMD_LOOPS; x++)
+  {
+    if (terminal_find_cmd(terminal_cmds[x % count].name) != NULL)
+      found++;
+    
+    if (terminal_find_cmd(misses[x % (sizeof(misses) / sizeof(misses[0]))]) != NULL)
+      found++;
+  }
+  
+  us = timer_ticks_to_us(timer_ticks() - start);
+  
+  printf("commands : %i in table, %i lookups (half misses) in %u us (%u ns/lookup)\n", 
+    count, BENCH_CMD_LOOPS * 2, us, (us * 500u) / BENCH_CMD_LOOPS);
+  return (found == BENCH_CMD_LOOPS) ? 0 : -1;
+}
+
+int bench_files()
+{
+  char name[16];
+  unsigned long long start;
+  unsigned long long reads;
+  unsigned int us;
+  int sector;
+  int expect;
+  int bytes;
+  int x;
+  
+  // Check every file lands where the card layout put it
+  expect = HOST_PART_START + 0x801;
+  
+  for (x = 0; x < HOST_FILES; x++)
+  {
+    snprintf(name, sizeof(name), "file%03i.dat", x);
+    
+    if (sd_find_file(name, &sector, &bytes) || (sector != expect) || (bytes != host_file_bytes(x)))
+    {
+      printf("ERROR: File '%s' not found at sector %i (%i bytes)\n", name, expect, host_file_bytes(x));
+      return -1;
+    }
+    
+    expect += host_file_sectors(bytes);
+  }
+  
+  if (sd_find_file("missing.dat", &sector, &bytes) == 0)
+  {
+    puts("ERROR: File 'missing.dat' should not be found");
+    return -1;
+  }
+  
+  reads = host_card_reads;
+  start = timer_ticks();
+  
+  for (x = 0; x < BENCH_FILE_LOOPS; x++)
+  {
+    snprintf(name, sizeof(name), "file%03i.dat", x % HOST_FILES);
+    sd_find_file(name, &sector, &bytes);
+  }
+  
+  us = timer_ticks_to_us(timer_ticks() - start);
+  reads = host_card_reads - reads;
+  
+  printf("files    : %i in header, %i lookups in %u us (%u ns/lookup, %llu card bytes/lookup)\n", 
+    HOST_FILES, BENCH_FILE_LOOPS, us, (us * 1000u) / BENCH_FILE_LOOPS, reads / BENCH_FILE_LOOPS);
+  return 0;
+}
+
+//
+// Checks
+//
+
+int check_log()
+{
+  static char *argv[] = {"log-dump", "clear"};
+  static char out[256];
+  char *line;
+  
+  log_dump(2, argv);
+  LOG_INFO("sd-rbf %u bytes", 1234);
+  
+  // NOTE: One line, "[    0.001234] I0: sd-rbf 1234 bytes"
+  host_uart_capture = out;
+  host_uart_capture_size = sizeof(out);
+  host_uart_captured = 0;
+  log_dump(1, argv);
+  flush();
+  host_uart_capture = NULL;
+  
+  line = strchr(out, ']');
+  
+  if ((out[0] != '[') || (line == NULL) || (strncmp(line, "] I0: sd-rbf 1234 bytes", 23) != 0))
+  {
+    printf("ERROR: Log line '%s' is not 'I0: sd-rbf 1234 bytes'\n", out);
+    return -1;
+  }
+  
+  printf("log      : %s", out);
+  return 0;
+}
+
+int bench()
+{
+  if (check_log() || bench_printf() || bench_cmds() || bench_files())
+  {
+    puts("ERROR: Host benchmark FAILED");
+    return 1;
+  }
+  
+  puts("PASSED");
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  char *image = NULL;
+  int x = 1;
+  
+  alt_16550_init(ALT_16550_DEVICE_SOCFPGA_UART1, (void*)0, 0, &_stdio_uart_handle);
+  
+  if ((argc > 2) && (strcmp(argv[1], "-i") == 0))
+  {
+    image = argv[2];
+    x = 3;
+  }
+  
+  if ((x != (argc - 1)) || ((strcmp(argv[x], "term") != 0) && ((image != NULL) || (strcmp(argv[x], "bench") != 0))))
+  {
+    puts("USAGE: host_bmx bench");
+    puts("       host_bmx [-i card.img] term");
+    return 1;
+  }
+  
+  if (image != NULL)
+  {
+    if (host_card_load(image))
+      return 1;
+  }
+  else
+  {
+    host_card_build();
+  }
+  
+  if (sd_card_init(0) != 0)
+    return 1;
+  
+  if (strcmp(argv[x], "term") == 0)
+  {
+    terminal();
+    return 0;
+  }
+  
+  return bench();
+}
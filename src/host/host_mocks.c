@@ -0,0 +1,326 @@
+/*
+  Host build mocks for 'make host-test'
+  
+  The portable modules (simple_stdio, simple_format, terminal and the SD card file
+  lookup) are built with the host compiler against these stand-ins:
+    UART    : stdin/stdout
+    SD card : an image file (i.e. the 'make sdcard' output) held in memory
+    timer   : host monotonic clock, in nanosecond ticks
+    boot/CPU1/log/DMA : just enough for the code above to link and run
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include "alt_16550_uart.h"
+#include "alt_interrupt.h"
+#include "alt_sdmmc.h"
+#include "alt_clock_manager.h"
+#include "timer.h"
+#include "boot.h"
+#include "cpu1.h"
+#include "sd_dma.h"
+#include "dma.h"
+
+//
+// UART
+//
+
+int host_uart_quiet;                // Count output instead of writing it (benchmarks)
+unsigned long long host_uart_bytes; // Bytes written so far
+char *host_uart_capture;            // Keep output here instead of writing it (checks)
+size_t host_uart_capture_size;
+size_t host_uart_captured;
+
+ALT_STATUS_CODE alt_16550_init(ALT_16550_DEVICE_t device, void *location, uint32_t clock_freq, ALT_16550_HANDLE_t *handle)
+{
+  handle->device = device;
+  handle->location = location;
+  handle->clock_freq = 100000000; // NOTE: Typical l4_sp clock
+  handle->data = 0;
+  handle->fcr = 0;
+  
+  return ALT_E_SUCCESS;
+}
+
+ALT_STATUS_CODE alt_16550_baudrate_set(ALT_16550_HANDLE_t *handle, uint32_t baudrate)
+{ return ALT_E_SUCCESS; }
+
+ALT_STATUS_CODE alt_16550_enable(ALT_16550_HANDLE_t *handle) { return ALT_E_SUCCESS; }
+ALT_STATUS_CODE alt_16550_disable(ALT_16550_HANDLE_t *handle) { return ALT_E_SUCCESS; }
+
+ALT_STATUS_CODE alt_16550_fifo_read(ALT_16550_HANDLE_t *handle, char *buffer, size_t count)
+{
+  ssize_t n;
+  
+  while (count > 0)
+  {
+    n = read(0, buffer, count);
+    
+    if (n <= 0)
+      exit(0); // NOTE: End of input ends the session
+    
+    buffer += n;
+    count -= n;
+  }
+  
+  return ALT_E_SUCCESS;
+}
+
+ALT_STATUS_CODE alt_16550_fifo_write(ALT_16550_HANDLE_t *handle, const char *buffer, size_t count)
+{
+  ssize_t n;
+  
+  host_uart_bytes += count;
+  
+  if (host_uart_capture != NULL)
+  {
+    n = (count < (host_uart_capture_size - 1 - host_uart_captured)) ? count : 
+      (host_uart_capture_size - 1 - host_uart_captured);
+    
+    memcpy(&host_uart_capture[host_uart_captured], buffer, n);
+    host_uart_captured += n;
+    host_uart_capture[host_uart_captured] = '\0';
+    return ALT_E_SUCCESS;
+  }
+  
+  while ((count > 0) && !host_uart_quiet)
+  {
+    n = write(1, buffer, count);
+    
+    if (n <= 0)
+      exit(1);
+    
+    buffer += n;
+    count -= n;
+  }
+  
+  return ALT_E_SUCCESS;
+}
+
+ALT_STATUS_CODE alt_16550_fifo_size_get_tx(ALT_16550_HANDLE_t *handle, uint32_t *size)
+{
+  *size = 128;
+  return ALT_E_SUCCESS;
+}
+
+ALT_STATUS_CODE alt_16550_fifo_level_get_tx(ALT_16550_HANDLE_t *handle, uint32_t *level)
+{
+  *level = 0; // NOTE: stdout takes everything at once
+  return ALT_E_SUCCESS;
+}
+
+ALT_STATUS_CODE alt_16550_fifo_level_get_rx(ALT_16550_HANDLE_t *handle, uint32_t *level)
+{
+  struct pollfd pfd;
+  
+  pfd.fd = 0;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  
+  // NOTE: End of input also reads as a byte, so fifo_read() sees it
+  *level = ((poll(&pfd, 1, 0) > 0) && (pfd.revents & (POLLIN | POLLHUP))) ? 1 : 0;
+  return ALT_E_SUCCESS;
+}
+
+ALT_STATUS_CODE alt_16550_line_status_get(ALT_16550_HANDLE_t *handle, uint32_t *status)
+{
+  *status = ALT_16550_LINE_STATUS_TEMT;
+  return ALT_E_SUCCESS;
+}
+
+ALT_STATUS_CODE alt_16550_int_enable_rx(ALT_16550_HANDLE_t *handle) { return ALT_E_SUCCESS; }
+ALT_STATUS_CODE alt_16550_int_disable_rx(ALT_16550_HANDLE_t *handle) { return ALT_E_SUCCESS; }
+ALT_STATUS_CODE alt_16550_int_enable_tx(ALT_16550_HANDLE_t *handle) { return ALT_E_SUCCESS; }
+ALT_STATUS_CODE alt_16550_int_disable_tx(ALT_16550_HANDLE_t *handle) { return ALT_E_SUCCESS; }
+
+ALT_STATUS_CODE alt_16550_int_status_get(ALT_16550_HANDLE_t *handle, ALT_16550_INT_STATUS_t *status)
+{
+  *status = ALT_16550_INT_STATUS_NONE;
+  return ALT_E_SUCCESS;
+}
+
+//
+// Interrupts (never enabled, stdio stays polled)
+//
+
+ALT_STATUS_CODE alt_int_isr_register(ALT_INT_INTERRUPT_t int_id, alt_int_callback_t callback, void *context)
+{ return ALT_E_ERROR; }
+
+ALT_STATUS_CODE alt_int_isr_unregister(ALT_INT_INTERRUPT_t int_id) { return ALT_E_SUCCESS; }
+ALT_STATUS_CODE alt_int_dist_enable(ALT_INT_INTERRUPT_t int_id) { return ALT_E_SUCCESS; }
+ALT_STATUS_CODE alt_int_dist_disable(ALT_INT_INTERRUPT_t int_id) { return ALT_E_SUCCESS; }
+ALT_STATUS_CODE alt_int_dist_target_set(ALT_INT_INTERRUPT_t int_id, uint32_t target) { return ALT_E_SUCCESS; }
+
+//
+// SD card
+//
+
+unsigned char *host_card;
+size_t host_card_size;
+unsigned long long host_card_reads; // Bytes read so far
+
+// Use a copy of 'data' as the card, rounded up to whole blocks
+void host_card_set(const unsigned char *data, size_t size)
+{
+  free(host_card);
+  
+  host_card_size = (size + 511) & ~((size_t) 511);
+  host_card = calloc(1, host_card_size);
+  
+  if (host_card == NULL)
+    exit(1);
+  
+  memcpy(host_card, data, size);
+}
+
+ALT_STATUS_CODE alt_sdmmc_init(void) { return ALT_E_SUCCESS; }
+ALT_STATUS_CODE alt_sdmmc_card_pwr_on(void) { return ALT_E_SUCCESS; }
+
+ALT_STATUS_CODE alt_sdmmc_card_identify(ALT_SDMMC_CARD_INFO_t *card_info)
+{
+  memset(card_info, 0, sizeof(ALT_SDMMC_CARD_INFO_t));
+  
+  if (host_card == NULL)
+    return ALT_E_ERROR;
+  
+  card_info->card_type = ALT_SDMMC_CARD_TYPE_SDHC;
+  card_info->blk_number_low = host_card_size / 512;
+  
+  return ALT_E_SUCCESS;
+}
+
+ALT_STATUS_CODE alt_sdmmc_card_bus_width_set(ALT_SDMMC_CARD_INFO_t *card_info, ALT_SDMMC_BUS_WIDTH_t width)
+{ return ALT_E_SUCCESS; }
+
+ALT_STATUS_CODE alt_sdmmc_fifo_param_set(uint32_t rx_wtrmk, uint32_t tx_wtrmk, ALT_SDMMC_MULT_TRANS_t mult_trans)
+{ return ALT_E_SUCCESS; }
+
+ALT_STATUS_CODE alt_sdmmc_card_misc_get(ALT_SDMMC_CARD_MISC_t *card_misc_cfg)
+{
+  memset(card_misc_cfg, 0, sizeof(ALT_SDMMC_CARD_MISC_t));
+  card_misc_cfg->block_size = 512;
+  card_misc_cfg->card_width = 4;
+  
+  return ALT_E_SUCCESS;
+}
+
+ALT_STATUS_CODE alt_sdmmc_card_clk_div_set(uint32_t clk_div) { return ALT_E_SUCCESS; }
+
+// NOTE: Like the target, 'src' is the byte offset on the card
+ALT_STATUS_CODE alt_sdmmc_read(ALT_SDMMC_CARD_INFO_t *card_info, void *dest, void *src, const size_t size)
+{
+  size_t offset;
+  
+  offset = (size_t) (uintptr_t) src;
+  
+  if ((host_card == NULL) || (offset > host_card_size) || (size > (host_card_size - offset)))
+    return ALT_E_ERROR;
+  
+  memcpy(dest, &host_card[offset], size);
+  host_card_reads += size;
+  
+  return ALT_E_SUCCESS;
+}
+
+// NOTE: No IDMAC here, so sd_read() always takes the PIO path
+int sd_dma_init(int block_addr) { return -1; }
+int sd_dma_read_start(void *dest, unsigned int size, unsigned int sector, unsigned int bytes) { return -1; }
+int sd_dma_read_poll() { return -1; }
+int sd_dma_read(void *dest, unsigned int sector, unsigned int bytes) { return -1; }
+int sd_dma_cmd(unsigned int cmd, unsigned int arg, unsigned int *resp) { return -1; }
+int sd_dma_read_block(unsigned int cmd, unsigned int arg, void *dest, unsigned int bytes) { return -1; }
+
+// NOTE: No DMA-330 either, FPGA writes would be done by the CPU
+int dma_available() { return 0; }
+int dma_start(int ch, void *dst, const void *src, unsigned int bytes, int flags) { return -1; }
+int dma_poll(int ch) { return -1; }
+void dma_kill(int ch) { return; }
+
+ALT_STATUS_CODE alt_clk_freq_get(ALT_CLK_t clk, uint32_t *freq)
+{
+  *freq = 200000000;
+  return ALT_E_SUCCESS;
+}
+
+//
+// Timer
+//
+
+void timer_init() { return; }
+
+// NOTE: Counts from the first call, like the target counts from reset
+unsigned long long timer_ticks()
+{
+  static unsigned long long base;
+  struct timespec ts;
+  unsigned long long ns;
+  
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ns = ((unsigned long long) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+  
+  if (base == 0)
+    base = ns - 1;
+  
+  return ns - base;
+}
+
+unsigned int timer_ticks_per_us() { return 1000; }
+
+unsigned int timer_ticks_to_us(unsigned long long ticks)
+{
+  ticks = ticks / 1000;
+  return (ticks > 0xFFFFFFFF) ? 0xFFFFFFFF : (unsigned int) ticks;
+}
+
+//
+// Boot and CPU1 (no boot sequence or second core on the host)
+//
+
+int boot_step_expired() { return 0; }
+
+void boot_async(int (*poll)(void *arg), void (*done)(int rtn, void *arg), void *arg, int background)
+{
+  int rtn;
+  
+  do
+  {
+    rtn = poll(arg);
+  } while (rtn == BOOT_BUSY);
+  
+  if (done)
+    done(rtn, arg);
+}
+
+void boot_async_wait_all() { return; }
+void boot_restart(int warm) { exit(0); }
+
+int cpu1_submit(int (*func)(void *arg), void *arg) { return -1; }
+int cpu1_is_done(int job) { return 1; }
+int cpu1_wait(int job) { return -1; }
+int cpu1_stop(int step) { return 0; }
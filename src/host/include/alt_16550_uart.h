@@ -0,0 +1,79 @@
+/*
+  Host build stand-in for the hwlib 16550 UART API (see src/host/host_mocks.c)
+  
+  Only what the portable modules use, backed by stdin/stdout
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#ifndef _HOST_ALT_16550_UART_H
+#define _HOST_ALT_16550_UART_H
+
+#include "hwlib.h"
+
+typedef enum
+{
+  ALT_16550_DEVICE_SOCFPGA_UART0 = 0,
+  ALT_16550_DEVICE_SOCFPGA_UART1 = 1
+} ALT_16550_DEVICE_t;
+
+typedef struct
+{
+  ALT_16550_DEVICE_t device;
+  void *location;
+  uint32_t clock_freq;
+  uint32_t data;
+  uint32_t fcr;
+} ALT_16550_HANDLE_t;
+
+#define ALT_16550_BAUDRATE_115200 115200
+
+#define ALT_16550_LINE_STATUS_TEMT 0x40
+
+typedef enum
+{
+  ALT_16550_INT_STATUS_NONE = 0x1,
+  ALT_16550_INT_STATUS_TX_IDLE = 0x2,
+  ALT_16550_INT_STATUS_RX_DATA = 0x4
+} ALT_16550_INT_STATUS_t;
+
+ALT_STATUS_CODE alt_16550_init(ALT_16550_DEVICE_t device, void *location, uint32_t clock_freq, ALT_16550_HANDLE_t *handle);
+ALT_STATUS_CODE alt_16550_baudrate_set(ALT_16550_HANDLE_t *handle, uint32_t baudrate);
+ALT_STATUS_CODE alt_16550_enable(ALT_16550_HANDLE_t *handle);
+ALT_STATUS_CODE alt_16550_disable(ALT_16550_HANDLE_t *handle);
+
+ALT_STATUS_CODE alt_16550_fifo_read(ALT_16550_HANDLE_t *handle, char *buffer, size_t count);
+ALT_STATUS_CODE alt_16550_fifo_write(ALT_16550_HANDLE_t *handle, const char *buffer, size_t count);
+ALT_STATUS_CODE alt_16550_fifo_size_get_tx(ALT_16550_HANDLE_t *handle, uint32_t *size);
+ALT_STATUS_CODE alt_16550_fifo_level_get_tx(ALT_16550_HANDLE_t *handle, uint32_t *level);
+ALT_STATUS_CODE alt_16550_fifo_level_get_rx(ALT_16550_HANDLE_t *handle, uint32_t *level);
+ALT_STATUS_CODE alt_16550_line_status_get(ALT_16550_HANDLE_t *handle, uint32_t *status);
+
+ALT_STATUS_CODE alt_16550_int_enable_rx(ALT_16550_HANDLE_t *handle);
+ALT_STATUS_CODE alt_16550_int_disable_rx(ALT_16550_HANDLE_t *handle);
+ALT_STATUS_CODE alt_16550_int_enable_tx(ALT_16550_HANDLE_t *handle);
+ALT_STATUS_CODE alt_16550_int_disable_tx(ALT_16550_HANDLE_t *handle);
+ALT_STATUS_CODE alt_16550_int_status_get(ALT_16550_HANDLE_t *handle, ALT_16550_INT_STATUS_t *status);
+
+#endif
@@ -0,0 +1,47 @@
+/*
+  Host build stand-in for the hwlib interrupt API (see src/host/host_mocks.c)
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#ifndef _HOST_ALT_INTERRUPT_H
+#define _HOST_ALT_INTERRUPT_H
+
+#include "hwlib.h"
+
+typedef enum
+{
+  ALT_INT_INTERRUPT_UART0 = 142,
+  ALT_INT_INTERRUPT_UART1 = 143
+} ALT_INT_INTERRUPT_t;
+
+typedef void (*alt_int_callback_t)(uint32_t icciar, void *context);
+
+ALT_STATUS_CODE alt_int_isr_register(ALT_INT_INTERRUPT_t int_id, alt_int_callback_t callback, void *context);
+ALT_STATUS_CODE alt_int_isr_unregister(ALT_INT_INTERRUPT_t int_id);
+ALT_STATUS_CODE alt_int_dist_enable(ALT_INT_INTERRUPT_t int_id);
+ALT_STATUS_CODE alt_int_dist_disable(ALT_INT_INTERRUPT_t int_id);
+ALT_STATUS_CODE alt_int_dist_target_set(ALT_INT_INTERRUPT_t int_id, uint32_t target);
+
+#endif
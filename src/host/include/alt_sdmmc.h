@@ -0,0 +1,91 @@
+/*
+  Host build stand-in for the hwlib SD/MMC API (see src/host/host_mocks.c)
+  
+  The card is backed by an image file (i.e. the 'make sdcard' output)
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#ifndef _HOST_ALT_SDMMC_H
+#define _HOST_ALT_SDMMC_H
+
+#include "hwlib.h"
+
+typedef enum
+{
+  ALT_SDMMC_CARD_TYPE_NOTDETECT = 0,
+  ALT_SDMMC_CARD_TYPE_MMC = 1,
+  ALT_SDMMC_CARD_TYPE_SD = 2,
+  ALT_SDMMC_CARD_TYPE_SDIOIO = 3,
+  ALT_SDMMC_CARD_TYPE_SDIOCOMBO = 4,
+  ALT_SDMMC_CARD_TYPE_SDHC = 5
+} ALT_SDMMC_CARD_TYPE_t;
+
+typedef struct
+{
+  ALT_SDMMC_CARD_TYPE_t card_type;
+  uint32_t rca;
+  uint32_t xfer_speed;
+  uint32_t max_r_blkln;
+  uint32_t max_w_blkln;
+  uint32_t blk_number_high;
+  uint32_t blk_number_low;
+} ALT_SDMMC_CARD_INFO_t;
+
+typedef struct
+{
+  uint32_t response_timeout;
+  uint32_t data_timeout;
+  uint32_t card_width;
+  uint32_t block_size;
+  uint32_t debounce_count;
+} ALT_SDMMC_CARD_MISC_t;
+
+typedef enum
+{
+  ALT_SDMMC_BUS_WIDTH_1 = 1,
+  ALT_SDMMC_BUS_WIDTH_4 = 4,
+  ALT_SDMMC_BUS_WIDTH_8 = 8
+} ALT_SDMMC_BUS_WIDTH_t;
+
+typedef enum
+{
+  ALT_SDMMC_MULT_TRANS_TXMSIZE1 = 0,
+  ALT_SDMMC_MULT_TRANS_TXMSIZE4 = 1,
+  ALT_SDMMC_MULT_TRANS_TXMSIZE8 = 2,
+  ALT_SDMMC_MULT_TRANS_TXMSIZE16 = 3
+} ALT_SDMMC_MULT_TRANS_t;
+
+#define ALT_SDMMC_FIFO_NUM_ENTRIES 1024
+
+ALT_STATUS_CODE alt_sdmmc_init(void);
+ALT_STATUS_CODE alt_sdmmc_card_pwr_on(void);
+ALT_STATUS_CODE alt_sdmmc_card_identify(ALT_SDMMC_CARD_INFO_t *card_info);
+ALT_STATUS_CODE alt_sdmmc_card_bus_width_set(ALT_SDMMC_CARD_INFO_t *card_info, ALT_SDMMC_BUS_WIDTH_t width);
+ALT_STATUS_CODE alt_sdmmc_fifo_param_set(uint32_t rx_wtrmk, uint32_t tx_wtrmk, ALT_SDMMC_MULT_TRANS_t mult_trans);
+ALT_STATUS_CODE alt_sdmmc_card_misc_get(ALT_SDMMC_CARD_MISC_t *card_misc_cfg);
+ALT_STATUS_CODE alt_sdmmc_card_clk_div_set(uint32_t clk_div);
+ALT_STATUS_CODE alt_sdmmc_read(ALT_SDMMC_CARD_INFO_t *card_info, void *dest, void *src, const size_t size);
+
+#endif
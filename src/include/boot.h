@@ -40,18 +40,164 @@ void shutdown();
 // Add new steps to boot sequence using the following MACRO
 // Example: BOOT_STEP(15, my_boot_func, "my stuff"); // call 'my_boot_func()' at step 15
 //
-// NOTE: Boot steps are from 1-999, shutdown steps are from 1000-1999, others steps are ignored
+// Steps return 0 on success, anything else is an error code (see BOOT_FAIL_* flags)
+//
+// NOTE: Boot steps are from 1-999, shutdown steps are from 1000-1999
+// NOTE: STEP must be a plain decimal number. It is pasted into the section name so
+//       the linker can sort the table by step (see ocram.lds), and into a symbol
+//       name so two steps with the same number fail to link. Steps outside of
+//       1-1999 fail to compile.
 
 #define BOOT_STEP(STEP, ENTRY, DESC) \
-__attribute__((section(".boot_steps"))) boot_step_t btable_##ENTRY = {.step = STEP, .entry = ENTRY, .desc = DESC}
+BOOT_STEP_CHECK(STEP, ENTRY); \
+__attribute__((section(".boot_steps." #STEP))) boot_step_t btable_##ENTRY = {.step = STEP, .entry = ENTRY, .desc = DESC, .name = #ENTRY}
 
-typedef struct
+//
+// Steps added with BOOT_STEP depend on every earlier step in the same sequence (boot
+// or shutdown). Use BOOT_STEP_DEPS to only depend on the named steps instead.
+// Example: BOOT_STEP_DEPS(310, i2c_init, "init i2c bus", clock_init, pinmux_init);
+//
+// NOTE: Prerequisites are the ENTRY names of other steps, steps are still run in step
+//       order unless a prerequisite has a higher step number
+
+#define BOOT_STEP_DEPS(STEP, ENTRY, DESC, ...) \
+BOOT_STEP_CHECK(STEP, ENTRY); \
+__attribute__((section(".boot_steps." #STEP))) boot_step_t btable_##ENTRY = {.step = STEP, .entry = ENTRY, .desc = DESC, .name = #ENTRY, .deps = #__VA_ARGS__}
+
+//
+// Use BOOT_STEP_OPTS to set any other field of the step, given as designated initializers
+// Example: BOOT_STEP_OPTS(30, pinmux_init, "init pinmux", .flags = BOOT_WARM_SKIP);
+// Example: BOOT_STEP_OPTS(300, sd_card_init, "init sdmmc card", .flags = BOOT_FAIL_SKIP, 
+//                         .retries = 2, .budget_us = 2000000);
+//
+
+#define BOOT_STEP_OPTS(STEP, ENTRY, DESC, ...) \
+BOOT_STEP_CHECK(STEP, ENTRY); \
+__attribute__((section(".boot_steps." #STEP))) boot_step_t btable_##ENTRY = {.step = STEP, .entry = ENTRY, .desc = DESC, .name = #ENTRY, __VA_ARGS__}
+
+#define BOOT_STEP_CHECK(STEP, ENTRY) \
+typedef char btable_range_##ENTRY[(((STEP) >= 1) && ((STEP) <= 1999)) ? 1 : -1]; \
+__attribute__((section(".boot_step_ids"))) char boot_step_id_##STEP = 0
+
+#define BOOT_STEPS_MAX 128 // Steps covered by the 'requires' sets (see boot_schedule)
+
+typedef struct boot_step_s
 {
   int step;
-  void (*entry)(int);
+  int (*entry)(int);
   char *desc;
+  char *name;               // Name of entry function (used to match prerequisites)
+  char *deps;               // Prerequisite step names, or NULL for all earlier steps
+  struct boot_step_s *next; // Next step in scheduled order
+  int level;                // Dependency depth, steps with the same level are independent
+  int pending;              // Unscheduled prerequisite count (only used while scheduling)
+  int index;                // Position in the table, or -1 past BOOT_STEPS_MAX
+  unsigned int requires[BOOT_STEPS_MAX / 32]; // Bit per table position, direct or indirect
+  unsigned long long start; // Timer value when last run started
+  unsigned long long ticks; // Duration of last run in global timer ticks (see 'boot-profile')
+  unsigned int usec;        // Duration of last run in microseconds
+  unsigned int entry_usec;  // Part of 'usec' in the entry, the rest (asynchronous) overlaps later steps
+  int (*async_poll)(void *arg);            // Pending asynchronous work (see boot_async)
+  void (*async_done)(int rtn, void *arg);
+  void *async_arg;
+  int async_background;
+  int flags;                // BOOT_WARM_SKIP, BOOT_FAIL_SKIP, etc.
+  int retries;              // Extra attempts if the entry returns an error
+  unsigned int budget_us;   // Time budget in microseconds, 0 for none
+  int status;               // Result of last run (BOOT_BUSY while asynchronous work is pending)
+  int (*warm_valid)(int step); // Optional check that a warm skip is still safe
+  int done;                 // Ran to completion since the last cold boot
+  int skipped;              // Skipped on this (warm) boot
 } boot_step_t;
 
-extern boot_step_t boot_steps[]; // NOTE: Defined in linker script
+//
+// Step flags
+// - BOOT_WARM_SKIP: Step is restart-idempotent. After a warm restart it is skipped if it
+//   already ran (and its 'warm_valid' callback, if any, returns non-zero). Anything the
+//   step sets up in memory must be kept in BOOT_RETAINED variables, since .bss is cleared.
+// - BOOT_FAIL_SKIP: If the step fails, skip every step that requires it
+// - BOOT_FAIL_ABORT: If the step fails, stop the boot sequence and go on to main()
+//   (steps without either flag fail on their own and boot continues)
+//
+// Step time budgets
+// - A step (and its asynchronous work) that runs over 'budget_us' is reported
+// - Pending foreground asynchronous work is abandoned with BOOT_TIMEOUT once over budget
+// - Steps that busy-wait on hardware should give up when boot_step_expired() returns
+//   non-zero (it is always zero outside of a step, and on CPU1)
+//
+
+#define BOOT_WARM_SKIP  0x00000001
+#define BOOT_FAIL_SKIP  0x00000002
+#define BOOT_FAIL_ABORT 0x00000004
+
+#define BOOT_TIMEOUT -1000 // Status of a step that ran out of time
+#define BOOT_BLOCKED -1001 // Status of a step skipped because a prerequisite failed
+#define BOOT_NOT_RUN -1002 // Status of a step that has not run (yet)
+
+int boot_step_expired();
+
+extern boot_step_t boot_steps[]; // NOTE: Defined in linker script, sorted by step number
+
+//
+// Dependency graph helpers
+//
+
+extern boot_step_t *boot_sequence; // Scheduled order, boot steps first then shutdown steps
+
+void boot_schedule(); // Build 'boot_sequence' from the table (done by boot())
+
+int boot_step_depends(boot_step_t *step, boot_step_t *prereq);  // Direct prerequisite
+int boot_step_requires(boot_step_t *step, boot_step_t *prereq); // Direct or indirect
+int boot_steps_independent(boot_step_t *a, boot_step_t *b);     // Safe to overlap
+
+//
+// Asynchronous boot steps
+// - A step starts an operation and calls boot_async() before returning
+// - boot() keeps running later steps, calling 'poll' between them, and only waits for
+//   the operation when it gets to a step that requires this one
+// - 'poll' returns BOOT_BUSY until the operation is finished, then its result, which is
+//   handed to 'done' (if not NULL) and becomes the step's status
+// - Retries only apply to the step entry, not to the asynchronous operation
+// - Background operations progress without being polled (i.e. on CPU1), so boot() does
+//   not wait for them before returning. Everything else is finished by the end of boot.
+//
+// Example:
+//   int my_step(int step)
+//   {
+//     my_start_transfer();
+//     boot_async(my_poll_transfer, my_report_transfer, (void*)0, 0);
+//     return 0;
+//   }
+//
+
+#define BOOT_BUSY 1
+
+void boot_async(int (*poll)(void *arg), void (*done)(int rtn, void *arg), void *arg, int background);
+void boot_async_poll();     // Poll all pending operations once
+void boot_async_wait_all(); // Wait for all pending operations (including background)
+
+//
+// Warm restart
+// - Variables marked BOOT_RETAINED are placed outside of .bss (see ocram.lds) and keep
+//   their value across a warm restart. They are cleared by boot() on a cold boot.
+// - boot_restart(1) restarts skipping BOOT_WARM_SKIP steps, boot_restart(0) runs all steps
+//
+
+#define BOOT_RETAINED __attribute__((section(".retained")))
+
+#define BOOT_RETAINED_MAGIC 0x57A4B007
+#define BOOT_RETAINED_WARM  0x00000001
+
+typedef struct
+{
+  unsigned int magic;  // BOOT_RETAINED_MAGIC if flags are valid
+  unsigned int flags;  // BOOT_RETAINED_WARM, etc.
+} boot_retained_t;
+
+extern int boot_warm; // Non-zero if this is a warm restart
+extern unsigned long long boot_start_ticks; // Wall clock span of boot(), see 'boot-profile'
+extern unsigned long long boot_end_ticks;   // 0 until boot() returns
+
+void boot_restart(int warm);
 
 #endif
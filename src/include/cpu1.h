@@ -0,0 +1,52 @@
+/*
+  Second Cortex-A9 core (CPU1) as a boot worker
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#ifndef _CPU1_H_
+#define _CPU1_H_
+
+//
+// CPU1 is released from reset by a boot step and then waits for jobs from CPU0.
+// Jobs run in order, one at a time. A job must not use stdio or hardware that
+// CPU0 is using at the same time - return an error code and let CPU0 report it.
+//
+// Example:
+//   job = cpu1_submit(my_long_func, &my_args); // returns -1 if CPU1 can not take it
+//   ...
+//   rtn = cpu1_wait(job);                      // returns my_long_func()'s return value
+//
+
+int cpu1_is_running();
+
+int cpu1_submit(int (*func)(void *arg), void *arg); // Returns job number or -1
+int cpu1_is_done(int job);
+int cpu1_wait(int job);
+void cpu1_join(); // Wait for all submitted jobs to finish
+
+int cpu1_start(int step);  // Boot step (also usable after cpu1_stop)
+int cpu1_stop(int step);   // Shutdown step, waits for jobs and puts CPU1 back in reset
+
+#endif
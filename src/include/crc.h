@@ -0,0 +1,48 @@
+/*
+  CRC helpers (small nibble tables, suited to OCRAM)
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#ifndef _CRC_H_
+#define _CRC_H_
+
+//
+// CRC-16/CCITT-FALSE (poly 0x1021, MSB first)
+// - Start with CRC16_INIT, feed the result back in to continue over more data
+//
+
+#define CRC16_INIT 0xFFFF
+#define CRC16_XMODEM_INIT 0x0000 // Same polynomial, as used by XMODEM/YMODEM (sent MSB first)
+
+unsigned short crc16(unsigned short crc, const void *buf, int len);
+
+//
+// CRC-32 (IEEE 802.3, same as zlib)
+// - Start with 0, feed the result back in to continue over more data
+//
+
+unsigned int crc32(unsigned int crc, const void *buf, int len);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+  HPS DMA controller (ARM DMA-330 / PL330) channel API
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#ifndef _DMA_H_
+#define _DMA_H_
+
+//
+// Each channel runs a small program (built in OCRAM) that copies a block of words.
+// Like sd_dma.h, a copy is started and then polled, the CPU is free in between.
+//
+// Example:
+//   dma_start(DMA_CH_MEMCPY, dst, src, bytes, 0);
+//   while (dma_poll(DMA_CH_MEMCPY) == BOOT_BUSY)
+//     ...                                         // CPU is free here
+//
+// NOTE: Addresses and sizes must be word aligned, up to DMA_MAX_BYTES per copy.
+//       The source is cleaned and the destination invalidated in the cache, so do not
+//       touch memory sharing a cache line with the destination while a copy runs.
+//
+
+#define DMA_CHANNELS 8
+#define DMA_MAX_BYTES (2 * 1024 * 1024 - 4)
+
+// Channel plan - one user per channel (the shared debug registers are locked in dma.c)
+#define DMA_CH_FPGAMGR 0 // FPGA image data (sd_card.c)
+#define DMA_CH_MEMCPY  1 // dma_memcpy()
+
+// Copy flags
+#define DMA_DST_PORT 0x00000001 // Destination is a data port, every burst goes to the same address
+
+int dma_init(int step);   // Boot step, releases the controller from reset
+int dma_uninit(int step); // Shutdown step, back into reset
+int dma_available();
+
+int dma_start(int ch, void *dst, const void *src, unsigned int bytes, int flags); // Returns 0 or -1
+int dma_poll(int ch);     // BOOT_BUSY while running, then 0 or an error code
+int dma_wait(int ch);     // Poll until done
+void dma_kill(int ch);    // Stop a running copy
+
+int dma_memcpy(void *dst, const void *src, unsigned int bytes); // Start and wait
+
+#endif
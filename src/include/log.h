@@ -0,0 +1,78 @@
+/*
+  Deferred binary logging
+  
+  LOG_xxx() only records the format string address, a timestamp and up to four
+  32-bit arguments in an OCRAM ring. Formatting is done later by 'log-dump', or
+  on the build host by src/tools/log_decode using the strings in the ELF.
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <stdint.h>
+
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// NOTE: Messages above this level are removed at compile time (i.e. -DLOG_LEVEL=4)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+//
+// NOTE: Arguments are stored as raw 32-bit words, so no 64-bit (%ll) values and %s
+//       must point at a string that still exists when dumped (i.e. a literal)
+//
+
+#define LOG(LEVEL, ...) \
+  do { if ((LEVEL) <= LOG_LEVEL) LOG_RECORD_(LEVEL, __VA_ARGS__, 0, 0, 0, 0, 0); } while (0)
+
+#define LOG_RECORD_(LEVEL, FMT, A, B, C, D, ...) \
+  log_record(LEVEL, FMT, (uint32_t) (A), (uint32_t) (B), (uint32_t) (C), (uint32_t) (D))
+
+#define LOG_ERROR(...) LOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)  LOG(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...)  LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+// NOTE: Each CPU has its own ring (no atomics needed), 'log-dump' merges them by time
+typedef struct
+{
+  uint32_t seq;   // Record number + 1, written last (0 = empty or being written)
+  uint32_t level;
+  uint32_t ticks_lo;
+  uint32_t ticks_hi;
+  const char *fmt;
+  uint32_t arg[4];
+} log_entry_t;
+
+#define LOG_ENTRIES 64 // Per CPU, must be a power of 2
+
+void log_record(uint32_t level, const char *fmt, uint32_t a, uint32_t b, uint32_t c, uint32_t d);
+
+#endif
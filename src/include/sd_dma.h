@@ -0,0 +1,70 @@
+/*
+  SD card reads by the SDMMC internal DMA controller (IDMAC)
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#ifndef _SD_DMA_H_
+#define _SD_DMA_H_
+
+//
+// One multi-block read (CMD18) at a time, described by a descriptor chain in OCRAM.
+// The caller is free while it runs - start it, do other work, poll until done.
+//
+// NOTE: Buffers must start on a cache line and be a whole number of sectors, since
+//       the cache lines they cover are invalidated (see sd_read() in sd_card.c for
+//       the fallback to PIO).
+//
+// Example:
+//   sd_dma_read_start(buf, sizeof(buf), sector, sizeof(buf));
+//   while (sd_dma_read_poll() == BOOT_BUSY)
+//     ...                                      // CPU is free here
+//
+
+#define SD_DMA_ALIGN 32                         // Cache line size
+#define SD_DMA_DESC_BYTES 4096                  // Bytes per descriptor
+#define SD_DMA_DESCS 16
+#define SD_DMA_MAX_BYTES (SD_DMA_DESCS * SD_DMA_DESC_BYTES)
+#define SD_DMA_BURST_WORDS 8                    // FIFOTH.MSIZE set by sd_card_init()
+
+int sd_dma_init(int block_addr);  // 'block_addr' is set for high capacity cards, returns 0 if usable
+
+// Read 'bytes' from 'sector' into 'dest', wrapping around after 'size' bytes
+// - 'size' is normally 'bytes', a smaller ring just keeps the last data (benchmarks)
+int sd_dma_read_start(void *dest, unsigned int size, unsigned int sector, unsigned int bytes);
+int sd_dma_read_poll();           // BOOT_BUSY while running, then 0 or an error code
+
+int sd_dma_read(void *dest, unsigned int sector, unsigned int bytes); // Start and wait
+
+//
+// Single commands for card setup (see sd_card_speed() in sd_card.c)
+// - Short response commands only, 'resp' may be NULL
+// - sd_dma_read_block() reads one data block of 'bytes' (i.e. 8 for the SCR, 64 for
+//   the CMD6 switch status), 'dest' must cover whole cache lines
+//
+
+int sd_dma_cmd(unsigned int cmd, unsigned int arg, unsigned int *resp);
+int sd_dma_read_block(unsigned int cmd, unsigned int arg, void *dest, unsigned int bytes);
+
+#endif
@@ -0,0 +1,53 @@
+/*
+  printf style formatting core (no hardware dependencies, also built on the host)
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#ifndef _SIMPLE_FORMAT_H
+#define _SIMPLE_FORMAT_H
+
+#include <stdarg.h>
+
+//
+// Output streams into a sink, so printf() needs no intermediate buffer and
+// snprintf() can honor its size bound
+// - A sink stages bytes in buf and calls drain() when it is full, with no drain
+//   the extra bytes are only counted (truncation, or a pure counting sink)
+//
+
+typedef struct stdio_sink
+{
+  char *buf;
+  int pos;
+  int size;
+  int total; // Every byte produced, including any that were dropped
+  void (*drain)(struct stdio_sink *sink);
+} stdio_sink_t;
+
+// Returns the number of bytes produced (see total), supports %d %i %u %x %X %p %s
+// with optional '-', '0', width and 'l'/'ll' (64-bit) modifiers
+int stdio_format(stdio_sink_t *sink, char *f, va_list args);
+
+#endif
@@ -31,22 +31,53 @@ SOFTWARE.
 #ifndef _SIMPLE_STDIO_H
 #define _SIMPLE_STDIO_H
 
-typedef unsigned int size_t;
+#include <stdarg.h>
+#include <stddef.h>
 
 void chomp(char *s); // Remove tailing whitespace/newline
 
 void flush(); // Flush stdout (wait until all bytes are sent)
 
 int getchar(void);
+int getchar_nb(void); // Returns -1 if nothing has been typed
+int kbhit(void);      // Non-zero if getchar() would not wait
+int ctrlc(void);      // Non-zero (and drops pending input) if Ctrl-C was typed
 char *safe_gets(char *s, int max);
 char *gets(char *s);
 int putchar(int c);
 int puts(char *s);
 
+int getchar_timeout(unsigned int usec); // Returns -1 if nothing arrives in time
+
+extern unsigned int stdio_baudrate;         // Used by stdio_init() (board specific)
+unsigned int stdio_baudrate_max();          // Limited by the UART (l4_sp) clock
+unsigned int stdio_baudrate_actual(unsigned int baud); // 0 if more than 2.5% off
+int stdio_baudrate_set(unsigned int baud);  // Flushes first, no handshake (see 'baud')
+int stdio_irq_rearm();                      // Call after stdio_init() is re-run
+int write_raw(char *buf, int len);      // Binary output, no newline translation
+
 int printf(char *f, ...);
+int vprintf(char *f, va_list args);
 
+// NOTE: Return the full formatted length even when truncated to n,
+//       snprintf(0, 0, ...) just counts
 int snprintf(char *s, size_t n, char *f, ...);
+int vsnprintf(char *s, size_t n, char *f, va_list args);
 int sprintf(char *s, char *f, ...);
 int sscanf(char *s, char *f, ...);
 
+// Character classes, low bits are the (hex) digit value or 0x1F if not a digit
+extern const unsigned char simple_ctype[256];
+
+#define CTYPE_VALUE 0x1F
+#define CTYPE_SPACE 0x20
+
+#define simple_digit(C) (simple_ctype[(unsigned char) (C)] & CTYPE_VALUE)
+#define simple_isspace(C) (simple_ctype[(unsigned char) (C)] & CTYPE_SPACE)
+
+// NOTE: Base 0 picks hex for "0x", octal for "0" and decimal otherwise, *end is set to
+//       s if there are no digits (saturates at 0xFFFFFFFF on overflow)
+unsigned int strtou32(const char *s, char **end, int base);
+int strtos32(const char *s, char **end, int base);
+
 #endif
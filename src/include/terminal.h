@@ -36,9 +36,13 @@ void terminal();
 //
 // Add new commands to terminal using the following MACRO
 // Example: TERMINAL_COMMAND("my_cmd", my_cmd_func, "Help string for this command");
+//
+// NOTE: NAME must be a string literal. It is pasted into the section name so the linker
+//       sorts the (read-only) table by name (see ocram.lds), and the makefile scans the
+//       sources for it to build the command hash table (see src/tools/terminal_hash.c).
 
 #define TERMINAL_COMMAND(NAME, ENTRY, HELP) \
-__attribute__((section(".terminal_cmds"))) terminal_cmd_t ctable_##ENTRY = {.name = NAME, .entry = ENTRY, .help = HELP}
+__attribute__((section(".terminal_cmds." NAME))) const terminal_cmd_t ctable_##ENTRY = {.name = NAME, .entry = ENTRY, .help = HELP}
 
 typedef struct
 {
@@ -47,6 +51,29 @@ typedef struct
   char *help;
 } terminal_cmd_t;
 
-extern terminal_cmd_t terminal_cmds[]; // NOTE: Defined in linker script
+extern const terminal_cmd_t terminal_cmds[];   // NOTE: Defined in linker script, sorted by name
+extern const terminal_cmd_t terminal_cmds_end[];
+
+const terminal_cmd_t *terminal_find_cmd(char *name); // Returns NULL if not found
+
+//
+// Command name hash, shared with the table generator that runs on the build host
+// - FNV-1a, with a seed picked by the generator so no two commands share a slot
+//
+
+static inline unsigned int terminal_hash(const char *name, unsigned int seed)
+{
+  unsigned int hash;
+  
+  hash = 2166136261u ^ seed;
+  
+  while (*name != '\0')
+  {
+    hash ^= (unsigned char) *name++;
+    hash *= 16777619u;
+  }
+  
+  return hash ^ (hash >> 16);
+}
 
 #endif
@@ -33,22 +33,34 @@ SOFTWARE.
 
 extern ALT_16550_HANDLE_t _stdio_uart_handle;
 
-void stdio_init(int step)
+int stdio_init(int step)
 {
-  alt_16550_init(ALT_16550_DEVICE_SOCFPGA_UART1, (void*)0, 0, &_stdio_uart_handle);
-  alt_16550_baudrate_set(&_stdio_uart_handle, ALT_16550_BAUDRATE_115200);
-  alt_16550_line_config_set(&_stdio_uart_handle, ALT_16550_DATABITS_8, ALT_16550_PARITY_DISABLE, ALT_16550_STOPBITS_1);
-  alt_16550_fifo_enable(&_stdio_uart_handle);
-  alt_16550_enable(&_stdio_uart_handle);
+  ALT_STATUS_CODE status;
+  
+  status = alt_16550_init(ALT_16550_DEVICE_SOCFPGA_UART1, (void*)0, 0, &_stdio_uart_handle);
+  
+  if (status == ALT_E_SUCCESS)
+    status = alt_16550_baudrate_set(&_stdio_uart_handle, stdio_baudrate);
+  
+  if (status == ALT_E_SUCCESS)
+    status = alt_16550_line_config_set(&_stdio_uart_handle, ALT_16550_DATABITS_8, ALT_16550_PARITY_DISABLE, ALT_16550_STOPBITS_1);
+  
+  if (status == ALT_E_SUCCESS)
+    status = alt_16550_fifo_enable(&_stdio_uart_handle);
+  
+  if (status == ALT_E_SUCCESS)
+    status = alt_16550_enable(&_stdio_uart_handle);
+  
+  return status;
 }
 
-void print_name(int step)
-{ puts("\n *** Arria 10 SoC DevKit (Rev C) *** "); }
+int print_name(int step)
+{ puts("\n *** Arria 10 SoC DevKit (Rev C) *** "); return 0; }
 
-CLOCK_MANAGER_CONFIG clock_config;
-CLOCK_SOURCE_CONFIG clock_src_clks;
+BOOT_RETAINED CLOCK_MANAGER_CONFIG clock_config; // NOTE: Kept for a warm restart, clock_init may be skipped
+BOOT_RETAINED CLOCK_SOURCE_CONFIG clock_src_clks;
 
-void clock_init(int step)
+int clock_init(int step)
 {
   //
   // NOTE: Settings copied from DTS
@@ -108,12 +120,10 @@ void clock_init(int step)
   clock_src_clks.clk_freq_of_f2h_free = 100000000;
   clock_src_clks.clk_freq_of_cb_intosc_ls = 100000000;
   
-  alt_clkmgr_config(&clock_config, &clock_src_clks);
-  
-  return;
+  return alt_clkmgr_config(&clock_config, &clock_src_clks);
 }
 
-void pinmux_init(int step)
+int pinmux_init(int step)
 {
   int *shared_q1_pinmux = (int*) 0xFFD07000;
   int *shared_q2_pinmux = (int*) 0xFFD07030;
@@ -157,12 +167,12 @@ void pinmux_init(int step)
   dedicated_pincfg[16] = 0x0008282a;
   dedicated_pincfg[17] = 0x000a282a;
   
-  return;
+  return 0;
 }
 
 
-BOOT_STEP(20, clock_init, "configure clocks");
-BOOT_STEP(30, pinmux_init, "configure pinmux");
+BOOT_STEP_OPTS(20, clock_init, "configure clocks", .flags = BOOT_WARM_SKIP);
+BOOT_STEP_OPTS(30, pinmux_init, "configure pinmux", .flags = BOOT_WARM_SKIP);
 BOOT_STEP(40, stdio_init, "init stdio");
 BOOT_STEP(50, print_name, "display board identifier");
 
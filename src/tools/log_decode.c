@@ -0,0 +1,235 @@
+/*
+  Build host tool that formats a captured 'log-dump raw' listing
+  
+    usage: log_decode {image.elf} < capture.txt
+  
+  Format strings (and %s arguments) are looked up by address in the loaded
+  sections of the ELF, then formatted with the same code as the target.
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "simple_format.h"
+
+#define SHT_NOBITS 8
+#define SHF_ALLOC  0x2
+
+unsigned char *elf;
+long elf_size;
+
+uint32_t elf_word(long off) // NOTE: Target is little endian ELF32
+{
+  return elf[off] | (elf[off + 1] << 8) | (elf[off + 2] << 16) | ((uint32_t) elf[off + 3] << 24);
+}
+
+uint32_t elf_half(long off)
+{
+  return elf[off] | (elf[off + 1] << 8);
+}
+
+int elf_load(char *filename)
+{
+  FILE *fp;
+  
+  fp = fopen(filename, "rb");
+  
+  if (fp == NULL)
+    return -1;
+  
+  fseek(fp, 0, SEEK_END);
+  elf_size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  
+  elf = malloc(elf_size + 1);
+  
+  if ((elf == NULL) || (fread(elf, 1, elf_size, fp) != (size_t) elf_size))
+  {
+    fclose(fp);
+    return -2;
+  }
+  
+  fclose(fp);
+  elf[elf_size] = '\0';
+  
+  if ((elf_size < 52) || (memcmp(elf, "\177ELF", 4) != 0) || (elf[4] != 1) || (elf[5] != 1))
+    return -3;
+  
+  return 0;
+}
+
+// Find the string at a target address, null if it is not in a loaded section
+char *elf_string(uint32_t addr)
+{
+  uint32_t shoff;
+  uint32_t shentsize;
+  uint32_t shnum;
+  uint32_t x;
+  long sh;
+  
+  shoff = elf_word(32);
+  shentsize = elf_half(46);
+  shnum = elf_half(48);
+  
+  for (x = 0; x < shnum; x++)
+  {
+    sh = shoff + (x * shentsize);
+    
+    if ((sh + 40) > elf_size)
+      break;
+    
+    if ((elf_word(sh + 4) == SHT_NOBITS) || !(elf_word(sh + 8) & SHF_ALLOC))
+      continue;
+    
+    if ((addr >= elf_word(sh + 12)) && (addr < (elf_word(sh + 12) + elf_word(sh + 20))) &&
+        ((elf_word(sh + 16) + (addr - elf_word(sh + 12))) < (uint32_t) elf_size))
+      return (char*) &elf[elf_word(sh + 16) + (addr - elf_word(sh + 12))];
+  }
+  
+  return NULL;
+}
+
+void drain_stdout(stdio_sink_t *sink)
+{
+  int x;
+  
+  // NOTE: The target formatter turns "\n" into "\r\n"
+  for (x = 0; x < sink->pos; x++)
+    if (sink->buf[x] != '\r')
+      putchar(sink->buf[x]);
+  
+  sink->pos = 0;
+}
+
+int format(char *f, ...)
+{
+  stdio_sink_t sink;
+  char stage[64];
+  int rtn;
+  va_list args;
+  va_start(args, f);
+  
+  sink.buf = stage;
+  sink.pos = 0;
+  sink.size = sizeof(stage);
+  sink.total = 0;
+  sink.drain = drain_stdout;
+  
+  rtn = stdio_format(&sink, f, args);
+  
+  va_end(args);
+  return rtn;
+}
+
+// Arguments are raw words, but a %s one has to become a host pointer into the ELF
+void fixup_args(char *f, uintptr_t *arg)
+{
+  char *str;
+  int n;
+  
+  for (n = 0; (*f != '\0') && (n < 4); f++)
+  {
+    if (*f != '%')
+      continue;
+    
+    f++;
+    
+    if (*f == '%')
+      continue;
+    
+    while ((*f == '-') || ((*f >= '0') && (*f <= '9')) || (*f == 'l') || (*f == 'L'))
+      f++;
+    
+    if (*f == '\0')
+      break;
+    
+    if (*f == 's')
+    {
+      str = elf_string((uint32_t) arg[n]);
+      arg[n] = (uintptr_t) ((str != NULL) ? str : "(?)");
+    }
+    
+    n++;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  char line[256];
+  unsigned int cpu, level, hi, lo, fmt;
+  unsigned int a[4];
+  unsigned int ticks_per_us;
+  unsigned long long usec;
+  uintptr_t arg[4];
+  char *f;
+  int x;
+  
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: %s {image.elf} < capture.txt\n", argv[0]);
+    return -1;
+  }
+  
+  if (elf_load(argv[1]) != 0)
+  {
+    fprintf(stderr, "ERROR: Unable to read ELF32 file '%s'\n", argv[1]);
+    return -2;
+  }
+  
+  ticks_per_us = 1;
+  
+  while (fgets(line, sizeof(line), stdin) != NULL)
+  {
+    if (sscanf(line, "T %u", &ticks_per_us) == 1)
+      continue;
+    
+    if (sscanf(line, "L %u %u %x %x %x %x %x %x %x", &cpu, &level, &hi, &lo, &fmt, 
+               &a[0], &a[1], &a[2], &a[3]) != 9)
+      continue; // NOTE: Ignore the rest of the terminal session
+    
+    usec = (((unsigned long long) hi << 32) | lo) / ((ticks_per_us) ? ticks_per_us : 1);
+    printf("[%5llu.%06llu] %c%u: ", usec / 1000000, usec % 1000000, "?EWID"[(level > 4) ? 0 : level], cpu);
+    
+    f = elf_string(fmt);
+    
+    if (f == NULL)
+    {
+      printf("(unknown format %08x) %08x %08x %08x %08x\n", fmt, a[0], a[1], a[2], a[3]);
+      continue;
+    }
+    
+    for (x = 0; x < 4; x++)
+      arg[x] = a[x];
+    
+    fixup_args(f, arg);
+    format(f, arg[0], arg[1], arg[2], arg[3]);
+    putchar('\n');
+  }
+  
+  return 0;
+}
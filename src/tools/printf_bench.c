@@ -0,0 +1,427 @@
+/*
+  Build host microbenchmark for the printf formatting core
+  
+    usage: printf_bench [iterations]
+  
+  Compares the old divide-by-powers-of-ten decimal conversion against the
+  reciprocal/two-digit-table one in simple_format.c, then reports the
+  formatted bytes per second of stdio_format() for a mix of formats.
+  
+  NOTE: The host has a hardware divider, the Cortex A9 does not (each divide
+        is a libgcc call there), so the gap on the target is wider.
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "simple_format.h"
+
+double now_sec()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + ((double) ts.tv_nsec * 1e-9);
+}
+
+//
+// The formatter stdio used before, ten divides per decimal value then a pass to strip
+// zeros. The only change is that 'll' reads a 64-bit value and converts it the same
+// way (it printed %BAD% before), so both formatters produce the same bytes.
+//
+
+static inline void legacy_putc(stdio_sink_t *sink, char c)
+{
+  sink->total++;
+  
+  if (sink->pos >= sink->size)
+  {
+    if (sink->drain == (void*)0)
+      return;
+    
+    sink->drain(sink);
+  }
+  
+  sink->buf[sink->pos++] = c;
+}
+
+int legacy_format(stdio_sink_t *sink, char *f, va_list args)
+{
+  char *f_ptr;
+  int right_justify;
+  int zero_pad;
+  int field_width;
+  int long_arg;
+  char num_buf[32];
+  char *str;
+  int len;
+  int inum;
+  unsigned int unum;
+  unsigned long long lnum;
+  unsigned long long lx;
+  int x, y;
+  
+  f_ptr = f;
+  
+  while (*f_ptr != '\0')
+  {
+    if (*f_ptr == '%')
+    {
+      f_ptr++;
+      right_justify = 0;
+      zero_pad = 0;
+      field_width = 0;
+      long_arg = 0;
+      
+      if (*f_ptr == '%')
+      {
+        legacy_putc(sink, *f_ptr);
+        f_ptr++;
+        continue;
+      }
+      
+      if (*f_ptr == '-')
+      {
+        right_justify = 1;
+        f_ptr++;
+      }
+      
+      while (*f_ptr == '0')
+      {
+        zero_pad = 1;
+        f_ptr++;
+      }
+      
+      while ((*f_ptr >= '0') && (*f_ptr <= '9'))
+      {
+        field_width *= 10;
+        field_width += *f_ptr - '0';
+        f_ptr++;
+      }
+
+      while ((*f_ptr == 'l') || (*f_ptr == 'L'))
+      {
+        long_arg++;
+        f_ptr++;
+      }
+            
+      if ((*f_ptr == 'd') || (*f_ptr == 'i'))
+      {
+        inum = va_arg(args, int);
+        if (inum == 0)
+          str = "0";
+        else
+        {
+          str = num_buf;
+          if (inum < 0)
+          {
+            inum = -inum;
+            *str = '-';
+            str++;
+          }
+          x = 1000000000;
+          while (x > 0)
+          {
+            y = inum / x;
+            inum -= (y * x);
+            x = x / 10;
+            *str = ((char) (y & 0xF)) + '0';
+            str++;
+          }
+          *str = '\0';
+          str = num_buf;
+          if (*str == '-')
+          {
+            str++;
+            while (*str == '0')
+              str++;
+            str--;
+            *str = '-';
+          }
+          else
+          {
+            while (*str == '0')
+              str++;
+          }
+        }
+        f_ptr++;
+      }
+      else if ((*f_ptr == 'u') && (long_arg > 1))
+      {
+        lnum = va_arg(args, unsigned long long);
+        if (lnum == 0)
+          str = "0";
+        else
+        {
+          str = num_buf;
+          lx = 10000000000000000000ULL;
+          while (lx > 0)
+          {
+            y = (int) (lnum / lx);
+            lnum -= (y * lx);
+            lx = lx / 10;
+            *str = ((char) (y & 0xF)) + '0';
+            str++;
+          }
+          *str = '\0';
+          str = num_buf;
+          while (*str == '0')
+            str++;
+        }
+        f_ptr++;
+      }
+      else if (*f_ptr == 'u')
+      {
+        unum = va_arg(args, unsigned int);
+        if (unum == 0)
+          str = "0";
+        else
+        {
+          str = num_buf;
+          x = 1000000000;
+          while (x > 0)
+          {
+            y = unum / x;
+            unum -= (y * x);
+            x = x / 10;
+            *str = ((char) (y & 0xF)) + '0';
+            str++;
+          }
+          *str = '\0';
+          str = num_buf;
+          while (*str == '0')
+            str++;
+        }
+        f_ptr++;
+      }
+      else if ((*f_ptr == 'x') || (*f_ptr == 'X') || (*f_ptr == 'p'))
+      {
+        if (*f_ptr == 'p')
+        {
+          field_width = 8;
+          zero_pad = 1;
+          unum = (unsigned int) (uintptr_t) va_arg(args, void *);
+        }
+        else
+          unum = va_arg(args, unsigned int);
+          
+        if (unum == 0)
+          str = "0";
+        else
+        {
+          str = num_buf;
+          for (x = 0; x < 8; x++)
+          {
+            *str = (char) ((unum >> 28) & 0xF);
+            *str += '0';
+            if (*str > '9')
+            {
+              *str += 7;
+              if (*f_ptr == 'x')
+                *str += 0x20;
+            }
+            str++;
+            unum = (unum << 4);            
+          }
+          *str = '\0';
+          str = num_buf;
+          while (*str == '0')
+            str++;
+        }
+        f_ptr++;
+      }
+      else if (*f_ptr == 's')
+      {
+        str = va_arg(args, char *);
+        f_ptr++;
+      }
+      else
+      {
+        str = "%BAD%";
+        f_ptr++;
+      }
+      
+      if (long_arg && (*(f_ptr - 1) != 'u'))
+      { str = "%BAD%"; }
+      
+      len = strlen(str);
+      if (right_justify || zero_pad)
+      {
+        while (len < field_width)
+        {
+          legacy_putc(sink, (zero_pad) ? '0' : ' ');
+          len++;
+        }
+      }
+      while (*str != '\0')
+      {
+        legacy_putc(sink, *str);
+        str++;
+      }
+      while (len < field_width)
+      {
+        legacy_putc(sink, ' ');
+        len++;
+      }
+    }
+    else if (*f_ptr != '\0')
+    {
+      if (*f_ptr == '\n')
+        legacy_putc(sink, '\r');
+      
+      legacy_putc(sink, *f_ptr);
+      
+      if (*f_ptr == '\r')
+        legacy_putc(sink, '\n');
+      
+      f_ptr++;
+    }
+  }
+  
+  if ((sink->drain != (void*)0) && (sink->pos > 0))
+    sink->drain(sink);
+  
+  return sink->total;
+}
+
+//
+// Benchmark
+//
+
+typedef int (*format_t)(stdio_sink_t *sink, char *f, va_list args);
+
+void discard(stdio_sink_t *sink)
+{
+  sink->pos = 0;
+}
+
+int bench_format(format_t format, stdio_sink_t *sink, char *f, ...)
+{
+  int rtn;
+  va_list args;
+  va_start(args, f);
+  
+  rtn = format(sink, f, args);
+  
+  va_end(args);
+  return rtn;
+}
+
+// NOTE: The same line as bench_printf() in src/host/host_main.c
+#define BENCH_LINE "%i: 0x%08x %s %-10llu\n"
+#define BENCH_ARGS(x, v) (int) (x), (v), "sd-dump", 123456789012ULL + (v)
+
+// One pass of 'iter' lines, returns the seconds taken and the bytes in 'total'
+double bench_run(format_t format, int mixed, long iter, int *total)
+{
+  stdio_sink_t sink;
+  char stage[64];
+  unsigned int v;
+  long x;
+  double t0;
+  
+  sink.buf = stage;
+  sink.pos = 0;
+  sink.size = sizeof(stage);
+  sink.total = 0;
+  sink.drain = discard;
+  
+  // NOTE: Values spread over all lengths
+  t0 = now_sec();
+  for (x = 0, v = 1; x < iter; x++, v = (v * 1664525) + 1013904223)
+  {
+    if (mixed)
+      bench_format(format, &sink, BENCH_LINE, BENCH_ARGS(x, v));
+    else
+      bench_format(format, &sink, "%u\n", v >> (x & 31));
+  }
+  
+  *total = sink.total;
+  return now_sec() - t0;
+}
+
+// Both formatters must produce the same bytes for the benchmark lines
+int bench_check(long lines)
+{
+  stdio_sink_t sink[2];
+  char buf[2][128];
+  unsigned int v;
+  long x;
+  int y;
+  
+  for (x = 0, v = 1; x < lines; x++, v = (v * 1664525) + 1013904223)
+  {
+    for (y = 0; y < 2; y++)
+    {
+      sink[y].buf = buf[y];
+      sink[y].pos = 0;
+      sink[y].size = sizeof(buf[y]) - 1;
+      sink[y].total = 0;
+      sink[y].drain = (void*)0;
+      bench_format((y) ? stdio_format : legacy_format, &sink[y], BENCH_LINE, BENCH_ARGS(x, v));
+      buf[y][sink[y].pos] = '\0';
+    }
+    
+    if (strcmp(buf[0], buf[1]) != 0)
+    {
+      printf("ERROR: Formatters differ\n  before: %s  after: %s", buf[0], buf[1]);
+      return -1;
+    }
+  }
+  
+  return 0;
+}
+
+void bench_report(char *name, int mixed, long iter)
+{
+  double t[2];
+  int total[2];
+  int y;
+  
+  for (y = 0; y < 2; y++)
+    t[y] = bench_run((y) ? stdio_format : legacy_format, mixed, iter, &total[y]);
+  
+  printf("%s (%ld lines)\n", name, iter);
+  printf("  before: %8.2f ns/line %8.1f MB/s\n", (t[0] * 1e9) / iter, (total[0] / t[0]) / 1e6);
+  printf("   after: %8.2f ns/line %8.1f MB/s\n", (t[1] * 1e9) / iter, (total[1] / t[1]) / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+  long iter;
+  
+  iter = (argc > 1) ? atol(argv[1]) : 4000000;
+  
+  if (bench_check(100000))
+    return 1;
+  
+  bench_report("\"%u\\n\"", 0, iter);
+  bench_report("\"%i: 0x%08x %s %-10llu\\n\"", 1, iter);
+  
+  return 0;
+}
@@ -0,0 +1,223 @@
+/*
+  Build host tool that makes a perfect hash table for terminal commands
+  
+    usage: terminal_hash {source.c ...} > terminal_hash.h
+  
+  Scans the sources for TERMINAL_COMMAND("name", ...), sorts the names the same
+  way the linker sorts the command table and picks a seed for terminal_hash()
+  that gives every command its own slot.
+
+***
+
+Copyright (c) 2016 David M. Koltak
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of 
+this software and associated documentation files (the "Software"), to deal in the 
+Software without restriction, including without limitation the rights to use, 
+copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in 
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+  
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "terminal.h"
+
+#define MAX_CMDS 255 // NOTE: Index table uses one byte per slot, 0xFF is an empty slot
+#define MAX_NAME 64
+#define MAX_SEEDS 1000000
+
+char cmd_names[MAX_CMDS][MAX_NAME];
+int cmd_count;
+
+unsigned char hash_index[MAX_CMDS * 8];
+
+//
+// Find all TERMINAL_COMMAND("name" in one file
+//
+
+int scan_file(char *filename)
+{
+  FILE *fp;
+  char *buf;
+  char *ptr;
+  char *end;
+  long len;
+  
+  fp = fopen(filename, "rb");
+  if (fp == NULL)
+  {
+    fprintf(stderr, "ERROR: Unable to open '%s'\n", filename);
+    return -1;
+  }
+  
+  fseek(fp, 0, SEEK_END);
+  len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  
+  buf = malloc(len + 1);
+  if ((buf == NULL) || (fread(buf, 1, len, fp) != (size_t) len))
+  {
+    fprintf(stderr, "ERROR: Unable to read '%s'\n", filename);
+    fclose(fp);
+    return -1;
+  }
+  
+  buf[len] = '\0';
+  fclose(fp);
+  
+  ptr = buf;
+  while ((ptr = strstr(ptr, "TERMINAL_COMMAND(")) != NULL)
+  {
+    ptr += strlen("TERMINAL_COMMAND(");
+    
+    while ((*ptr == ' ') || (*ptr == '\t'))
+      ptr++;
+    
+    if (*ptr != '"')
+      continue;
+    
+    ptr++;
+    end = strchr(ptr, '"');
+    
+    if ((end == NULL) || ((end - ptr) >= MAX_NAME))
+    {
+      fprintf(stderr, "ERROR: Bad command name in '%s'\n", filename);
+      free(buf);
+      return -1;
+    }
+    
+    if (cmd_count >= MAX_CMDS)
+    {
+      fprintf(stderr, "ERROR: More than %i commands\n", MAX_CMDS);
+      free(buf);
+      return -1;
+    }
+    
+    memcpy(cmd_names[cmd_count], ptr, end - ptr);
+    cmd_names[cmd_count][end - ptr] = '\0';
+    cmd_count++;
+    
+    ptr = end;
+  }
+  
+  free(buf);
+  return 0;
+}
+
+int cmp_names(const void *a, const void *b)
+{ return strcmp((const char*) a, (const char*) b); }
+
+//
+// Try one seed, returns 0 if no two commands share a slot
+//
+
+int try_seed(unsigned int seed, unsigned int size)
+{
+  unsigned int slot;
+  int x;
+  
+  memset(hash_index, 0xFF, size);
+  
+  for (x = 0; x < cmd_count; x++)
+  {
+    slot = terminal_hash(cmd_names[x], seed) & (size - 1);
+    
+    if (hash_index[slot] != 0xFF)
+      return -1;
+    
+    hash_index[slot] = (unsigned char) x;
+  }
+  
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int size;
+  unsigned int seed;
+  int x;
+  
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s {source.c ...}\n", argv[0]);
+    return -1;
+  }
+  
+  for (x = 1; x < argc; x++)
+    if (scan_file(argv[x]))
+      return -1;
+  
+  // NOTE: Same order as SORT_BY_NAME in ocram.lds, so the index is the table position
+  qsort(cmd_names, cmd_count, MAX_NAME, cmp_names);
+  
+  for (x = 1; x < cmd_count; x++)
+  {
+    if (strcmp(cmd_names[x - 1], cmd_names[x]) == 0)
+    {
+      fprintf(stderr, "ERROR: Command '%s' is defined more than once\n", cmd_names[x]);
+      return -1;
+    }
+  }
+  
+  // NOTE: Start at twice the command count (rounded up to a power of 2), grow if needed
+  size = 2;
+  while (size < (unsigned int) (cmd_count * 2))
+    size <<= 1;
+  
+  while (1)
+  {
+    for (seed = 0; seed < MAX_SEEDS; seed++)
+      if (try_seed(seed, size) == 0)
+        break;
+    
+    if (seed < MAX_SEEDS)
+      break;
+    
+    if (size >= sizeof(hash_index))
+    {
+      fprintf(stderr, "ERROR: No perfect hash found\n");
+      return -1;
+    }
+    
+    size <<= 1;
+  }
+  
+  printf("//\n// Generated by src/tools/terminal_hash.c - DO NOT EDIT\n//\n\n");
+  printf("#define TERMINAL_HASH_SEED 0x%08X\n", seed);
+  printf("#define TERMINAL_HASH_SIZE %u\n", size);
+  printf("#define TERMINAL_HASH_COUNT %i\n\n", cmd_count);
+  
+  for (x = 0; x < cmd_count; x++)
+    printf("// %3i : %s\n", x, cmd_names[x]);
+  
+  printf("\nconst unsigned char terminal_hash_index[TERMINAL_HASH_SIZE] =\n{");
+  
+  for (x = 0; x < (int) size; x++)
+  {
+    if ((x % 16) == 0)
+      printf("\n  ");
+    
+    printf("0x%02X", hash_index[x]);
+    
+    if (x < (int) (size - 1))
+      printf(((x % 16) == 15) ? "," : ", ");
+  }
+  
+  printf("\n};\n");
+  
+  return 0;
+}